@@ -0,0 +1,387 @@
+// Performance suite for SearchServer. Built as a separate binary, see README.md.
+//
+// Usage:
+//   benchmark [--docs N] [--dictionary N] [--doc-words N] [--query-words N]
+//             [--queries N] [--zipf S] [--minus-prob P] [--warmup N] [--runs N]
+//             [--seed N] [--json FILE] [--compare FILE] [--threshold F]
+//
+// Every operation is warmed up and then measured --runs times. Latency
+// percentiles are taken over all measured calls of all runs.
+// With --compare the results are checked against a JSON file produced by an
+// earlier --json run; an operation whose p50 or p99 latency grew (or whose
+// throughput dropped) by more than --threshold is reported as a regression
+// and the process exits with code 1.
+
+#include "../search_server.h"
+#include "../generators.h"
+#include "../process_queries.h"
+#include "../remove_duplicates.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct Config {
+    int documents = 10'000;
+    int dictionary = 10'000;
+    int document_words = 70;
+    int query_words = 10;
+    int queries = 1'000;
+    double zipf = 1.0;
+    double minus_prob = 0.1;
+    int warmup = 1;
+    int runs = 5;
+    unsigned seed = 42;
+    string json_path;
+    string compare_path;
+    double threshold = 0.10;
+};
+
+struct Result {
+    string name;
+    size_t samples = 0;
+    double p50_ns = 0;
+    double p99_ns = 0;
+    double mean_ns = 0;
+    double throughput_ops = 0;
+};
+
+Config ParseArguments(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw invalid_argument("Missing value for "s + arg);
+        }
+        const string value = argv[++i];
+        if (arg == "--docs") {
+            config.documents = stoi(value);
+        } else if (arg == "--dictionary") {
+            config.dictionary = stoi(value);
+        } else if (arg == "--doc-words") {
+            config.document_words = stoi(value);
+        } else if (arg == "--query-words") {
+            config.query_words = stoi(value);
+        } else if (arg == "--queries") {
+            config.queries = stoi(value);
+        } else if (arg == "--zipf") {
+            config.zipf = stod(value);
+        } else if (arg == "--minus-prob") {
+            config.minus_prob = stod(value);
+        } else if (arg == "--warmup") {
+            config.warmup = stoi(value);
+        } else if (arg == "--runs") {
+            config.runs = max(1, stoi(value));
+        } else if (arg == "--seed") {
+            config.seed = static_cast<unsigned>(stoul(value));
+        } else if (arg == "--json") {
+            config.json_path = value;
+        } else if (arg == "--compare") {
+            config.compare_path = value;
+        } else if (arg == "--threshold") {
+            config.threshold = stod(value);
+        } else {
+            throw invalid_argument("Unknown argument "s + arg);
+        }
+    }
+    return config;
+}
+
+double Percentile(const vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t index = min(sorted.size() - 1, static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+
+// `run` performs one repetition and appends the latency of each measured call
+// (in nanoseconds) to the vector; `ops_per_sample` tells how many logical
+// operations one sample covers, for throughput.
+Result Measure(const string& name, const Config& config, const function<void(vector<double>&)>& run, size_t ops_per_sample = 1) {
+    vector<double> discarded;
+    for (int i = 0; i < config.warmup; ++i) {
+        run(discarded);
+        discarded.clear();
+    }
+    vector<double> samples;
+    for (int i = 0; i < config.runs; ++i) {
+        run(samples);
+    }
+    sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = name;
+    result.samples = samples.size();
+    result.p50_ns = Percentile(samples, 0.50);
+    result.p99_ns = Percentile(samples, 0.99);
+    const double total_ns = accumulate(samples.begin(), samples.end(), 0.0);
+    result.mean_ns = samples.empty() ? 0 : total_ns / samples.size();
+    result.throughput_ops = total_ns > 0 ? samples.size() * ops_per_sample * 1e9 / total_ns : 0;
+    return result;
+}
+
+template <typename Func>
+double TimeNs(Func&& func) {
+    const auto start = Clock::now();
+    func();
+    return chrono::duration<double, nano>(Clock::now() - start).count();
+}
+
+// Keeps the optimizer from dropping the measured calls
+volatile double sink = 0;
+
+vector<Result> RunSuite(const Config& config) {
+    mt19937 generator(config.seed);
+    const vector<string> dictionary = GenerateDictionary(generator, config.dictionary, 10);
+    const ZipfDistribution distribution(dictionary.size(), config.zipf);
+
+    cerr << "Generating "s << config.documents << " documents"s << endl;
+    vector<string> documents;
+    documents.reserve(config.documents);
+    for (int i = 0; i < config.documents; ++i) {
+        documents.push_back(GenerateZipfQuery(generator, dictionary, distribution, config.document_words));
+    }
+    const vector<string> queries = GenerateZipfQueries(generator, dictionary, distribution, config.queries, config.query_words, config.minus_prob);
+    // Documents that are added and removed again by the add/remove benchmarks
+    const int extra_count = max(1, min(config.documents, 1'000));
+    vector<string> extra_documents;
+    extra_documents.reserve(extra_count);
+    for (int i = 0; i < extra_count; ++i) {
+        extra_documents.push_back(GenerateZipfQuery(generator, dictionary, distribution, config.document_words));
+    }
+    const vector<int> ratings = {1, 2, 3};
+
+    vector<Result> results;
+    auto report = [&results](Result result) {
+        cerr << "  "s << left << setw(20) << result.name << right
+             << " p50 "s << setw(12) << fixed << setprecision(0) << result.p50_ns << " ns"s
+             << "  p99 "s << setw(12) << result.p99_ns << " ns"s
+             << "  "s << setw(14) << setprecision(1) << result.throughput_ops << " ops/s"s << endl;
+        results.push_back(move(result));
+    };
+
+    auto fill = [&](SearchServer& server) {
+        for (int i = 0; i < config.documents; ++i) {
+            server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, ratings);
+        }
+    };
+
+    cerr << "Running"s << endl;
+    report(Measure("bulk_add", config, [&](vector<double>& samples) {
+        SearchServer server(dictionary[0]);
+        samples.push_back(TimeNs([&] { fill(server); }));
+    }, config.documents));
+
+    SearchServer server(dictionary[0]);
+    fill(server);
+    const int first_extra_id = config.documents;
+
+    report(Measure("add", config, [&](vector<double>& samples) {
+        for (int i = 0; i < extra_count; ++i) {
+            samples.push_back(TimeNs([&] {
+                server.AddDocument(first_extra_id + i, extra_documents[i], DocumentStatus::ACTUAL, ratings);
+            }));
+        }
+        for (int i = 0; i < extra_count; ++i) {
+            server.RemoveDocument(first_extra_id + i);
+        }
+    }));
+
+    auto measure_remove = [&](auto policy) {
+        return [&, policy](vector<double>& samples) {
+            for (int i = 0; i < extra_count; ++i) {
+                server.AddDocument(first_extra_id + i, extra_documents[i], DocumentStatus::ACTUAL, ratings);
+            }
+            for (int i = 0; i < extra_count; ++i) {
+                samples.push_back(TimeNs([&] { server.RemoveDocument(policy, first_extra_id + i); }));
+            }
+        };
+    };
+    report(Measure("remove_seq", config, measure_remove(execution::seq)));
+    report(Measure("remove_par", config, measure_remove(execution::par)));
+
+    auto measure_match = [&](auto policy) {
+        return [&, policy](vector<double>& samples) {
+            mt19937 id_generator(config.seed);
+            for (const string& query : queries) {
+                const int document_id = uniform_int_distribution(0, config.documents - 1)(id_generator);
+                samples.push_back(TimeNs([&] {
+                    const auto [words, status] = server.MatchDocument(policy, query, document_id);
+                    sink = sink + words.size();
+                }));
+            }
+        };
+    };
+    report(Measure("match_seq", config, measure_match(execution::seq)));
+    report(Measure("match_par", config, measure_match(execution::par)));
+
+    auto measure_find = [&](auto policy) {
+        return [&, policy](vector<double>& samples) {
+            for (const string& query : queries) {
+                samples.push_back(TimeNs([&] {
+                    for (const Document& document : server.FindTopDocuments(policy, query)) {
+                        sink = sink + document.relevance;
+                    }
+                }));
+            }
+        };
+    };
+    report(Measure("find_seq", config, measure_find(execution::seq)));
+    report(Measure("find_par", config, measure_find(execution::par)));
+
+    report(Measure("process_queries", config, [&](vector<double>& samples) {
+        samples.push_back(TimeNs([&] { sink = sink + ProcessQueries(server, queries).size(); }));
+    }, queries.size()));
+
+    // Every second document of the corpus gets a duplicate
+    SearchServer duplicates_server(dictionary[0]);
+    const int duplicates_count = min(config.documents, 100'000);
+    for (int i = 0; i < duplicates_count; ++i) {
+        duplicates_server.AddDocument(i, documents[i / 2], DocumentStatus::ACTUAL, ratings);
+    }
+    report(Measure("remove_duplicates", config, [&](vector<double>& samples) {
+        SearchServer copy = duplicates_server;
+        // RemoveDuplicates reports every removed document to cout
+        ostringstream silent;
+        streambuf* const cout_buffer = cout.rdbuf(silent.rdbuf());
+        samples.push_back(TimeNs([&] { RemoveDuplicates(copy); }));
+        cout.rdbuf(cout_buffer);
+    }, duplicates_count));
+
+    return results;
+}
+
+void WriteJson(ostream& out, const Config& config, const vector<Result>& results) {
+    out << "{\n"s;
+    out << "  \"config\": {\"documents\": "s << config.documents
+        << ", \"dictionary\": "s << config.dictionary
+        << ", \"doc_words\": "s << config.document_words
+        << ", \"query_words\": "s << config.query_words
+        << ", \"queries\": "s << config.queries
+        << ", \"zipf\": "s << config.zipf
+        << ", \"minus_prob\": "s << config.minus_prob
+        << ", \"warmup\": "s << config.warmup
+        << ", \"runs\": "s << config.runs
+        << ", \"seed\": "s << config.seed << "},\n"s;
+    out << "  \"results\": [\n"s;
+    out << fixed << setprecision(1);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        // One result per line, ReadJson relies on it
+        out << "    {\"name\": \""s << result.name << "\""s
+            << ", \"samples\": "s << result.samples
+            << ", \"p50_ns\": "s << result.p50_ns
+            << ", \"p99_ns\": "s << result.p99_ns
+            << ", \"mean_ns\": "s << result.mean_ns
+            << ", \"throughput_ops\": "s << result.throughput_ops << "}"s
+            << (i + 1 < results.size() ? ","s : ""s) << "\n"s;
+    }
+    out << "  ]\n}\n"s;
+}
+
+double ReadNumber(const string& line, const string& key) {
+    const size_t pos = line.find("\""s + key + "\": "s);
+    if (pos == string::npos) {
+        throw invalid_argument("Missing field "s + key);
+    }
+    return stod(line.substr(pos + key.size() + 4));
+}
+
+// Reads the format produced by WriteJson
+map<string, Result> ReadJson(istream& in) {
+    map<string, Result> results;
+    string line;
+    while (getline(in, line)) {
+        const size_t pos = line.find("{\"name\": \""s);
+        if (pos == string::npos) {
+            continue;
+        }
+        Result result;
+        const size_t name_begin = pos + 10;
+        result.name = line.substr(name_begin, line.find('"', name_begin) - name_begin);
+        result.samples = static_cast<size_t>(ReadNumber(line, "samples"s));
+        result.p50_ns = ReadNumber(line, "p50_ns"s);
+        result.p99_ns = ReadNumber(line, "p99_ns"s);
+        result.mean_ns = ReadNumber(line, "mean_ns"s);
+        result.throughput_ops = ReadNumber(line, "throughput_ops"s);
+        results[result.name] = result;
+    }
+    return results;
+}
+
+// Returns the number of regressions found
+int Compare(const map<string, Result>& baseline, const vector<Result>& results, double threshold) {
+    int regressions = 0;
+    cerr << "Comparison against baseline (threshold "s << setprecision(0) << threshold * 100 << "%):"s << endl;
+    for (const Result& result : results) {
+        const auto it = baseline.find(result.name);
+        if (it == baseline.end()) {
+            cerr << "  "s << result.name << ": no baseline"s << endl;
+            continue;
+        }
+        const Result& base = it->second;
+        auto change = [](double before, double after) {
+            return before > 0 ? (after - before) / before : 0.0;
+        };
+        const double p50_change = change(base.p50_ns, result.p50_ns);
+        const double p99_change = change(base.p99_ns, result.p99_ns);
+        const double throughput_change = change(base.throughput_ops, result.throughput_ops);
+        const bool regressed = p50_change > threshold || p99_change > threshold || -throughput_change > threshold;
+        regressions += regressed;
+        cerr << "  "s << left << setw(20) << result.name << right << showpos << setprecision(1)
+             << " p50 "s << setw(7) << p50_change * 100 << "%"s
+             << "  p99 "s << setw(7) << p99_change * 100 << "%"s
+             << "  throughput "s << setw(7) << throughput_change * 100 << "%"s << noshowpos
+             << (regressed ? "  REGRESSION"s : ""s) << endl;
+    }
+    return regressions;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const Config config = ParseArguments(argc, argv);
+        const vector<Result> results = RunSuite(config);
+
+        if (config.json_path.empty()) {
+            WriteJson(cout, config, results);
+        } else {
+            ofstream out(config.json_path);
+            WriteJson(out, config, results);
+        }
+
+        if (!config.compare_path.empty()) {
+            ifstream in(config.compare_path);
+            if (!in) {
+                throw invalid_argument("Cannot open "s + config.compare_path);
+            }
+            if (Compare(ReadJson(in), results, config.threshold) > 0) {
+                return 1;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "bloom_filter.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+constexpr int PROBE_COUNT = 4;
+
+size_t GetBlock(uint64_t hash, size_t block_count) {
+    // Maps the high half of the hash onto [0, block_count) without a division
+    return static_cast<size_t>(((hash >> 32) * block_count) >> 32);
+}
+
+uint64_t GetMask(uint64_t hash) {
+    // Bit positions come from the low half of the hash, 6 bits each
+    uint64_t mask = 0;
+    for (int probe = 0; probe < PROBE_COUNT; ++probe) {
+        mask |= 1ull << ((hash >> (6 * probe)) & 63);
+    }
+    return mask;
+}
+
+}  // namespace
+
+void AddToBlocks(uint64_t* blocks, size_t block_count, uint64_t hash) {
+    blocks[GetBlock(hash, block_count)] |= GetMask(hash);
+}
+
+bool BlocksMayContain(const uint64_t* blocks, size_t block_count, uint64_t hash) {
+    if (block_count == 0) {
+        return false;
+    }
+    const uint64_t mask = GetMask(hash);
+    return (blocks[GetBlock(hash, block_count)] & mask) == mask;
+}
+
+BloomFilter::BloomFilter(size_t expected_count, size_t bits_per_key)
+    : blocks_(max<size_t>(1, GetBloomBlockCount(expected_count, bits_per_key)))
+    , capacity_(expected_count) {
+}
+
+void BloomFilter::Add(uint64_t hash) {
+    AddToBlocks(blocks_.data(), blocks_.size(), hash);
+}
+
+bool BloomFilter::MayContain(uint64_t hash) const {
+    return BlocksMayContain(blocks_.data(), blocks_.size(), hash);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Blocked Bloom filter over `block_count` blocks stored elsewhere: all bits of a
+// key lie in one 64-bit block, so a lookup touches a single cache line.
+void AddToBlocks(uint64_t* blocks, size_t block_count, uint64_t hash);
+bool BlocksMayContain(const uint64_t* blocks, size_t block_count, uint64_t hash);
+
+// Blocks needed for `key_count` keys at `bits_per_key`, zero for no keys
+inline size_t GetBloomBlockCount(size_t key_count, size_t bits_per_key) {
+    return (key_count * bits_per_key + 63) / 64;
+}
+
+// Approximate set of 64-bit hashes without false negatives, stored as blocks
+// described above. With the default 16 bits per key about 0.5% of absent keys
+// are reported as present.
+class BloomFilter {
+public:
+    BloomFilter() = default;
+
+    explicit BloomFilter(size_t expected_count, size_t bits_per_key = 16);
+
+    BloomFilter(const BloomFilter&) = default;
+    BloomFilter& operator=(const BloomFilter&) = default;
+    // A moved-from filter is empty with no capacity
+    BloomFilter(BloomFilter&& other) noexcept
+        : blocks_(std::move(other.blocks_))
+        , capacity_(std::exchange(other.capacity_, 0)) {
+    }
+    BloomFilter& operator=(BloomFilter&& other) noexcept {
+        blocks_ = std::move(other.blocks_);
+        capacity_ = std::exchange(other.capacity_, 0);
+        return *this;
+    }
+
+    void Add(uint64_t hash);
+
+    // False means the key was never added
+    bool MayContain(uint64_t hash) const;
+
+    // Number of keys the filter was sized for
+    size_t GetCapacity() const {
+        return capacity_;
+    }
+
+    size_t GetMemoryUsage() const {
+        return blocks_.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    std::vector<uint64_t> blocks_;
+    size_t capacity_ = 0;
+};
+
+// Hash of a term id for per-document filters
+inline uint64_t HashTermId(uint32_t term) {
+    // splitmix64 finalizer, dense ids need all bits mixed
+    uint64_t hash = term + 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
@@ -0,0 +1,203 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <execution>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 16 * 1024 * 1024;
+
+// Read-only private mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw runtime_error("Can not open "s + path);
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0) {
+            close(fd);
+            throw runtime_error("Can not stat "s + path);
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        if (size_ > 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                throw runtime_error("Can not map "s + path);
+            }
+            data_ = static_cast<const char*>(data);
+            madvise(data, size_, MADV_SEQUENTIAL);
+        }
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    string_view GetContent() const {
+        return {data_, size_};
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+struct Line {
+    string_view text;
+    size_t offset = 0;
+};
+
+[[noreturn]] void ThrowMalformed(size_t offset, string_view reason) {
+    throw invalid_argument("Malformed corpus line at byte "s + to_string(offset) + ": "s + string(reason));
+}
+
+string_view NextField(string_view& line, size_t offset) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        ThrowMalformed(offset, "expected 4 tab-separated fields"sv);
+    }
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+int ParseInt(string_view field, size_t offset) {
+    int value = 0;
+    const auto [end, error] = from_chars(field.data(), field.data() + field.size(), value);
+    if (error != errc() || end != field.data() + field.size()) {
+        ThrowMalformed(offset, "bad number"sv);
+    }
+    return value;
+}
+
+DocumentStatus ParseStatus(string_view field, size_t offset) {
+    if (field == "ACTUAL"sv) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (field == "IRRELEVANT"sv) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (field == "BANNED"sv) {
+        return DocumentStatus::BANNED;
+    }
+    if (field == "REMOVED"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    ThrowMalformed(offset, "unknown status"sv);
+}
+
+DocumentRecord ParseLine(const Line& line) {
+    string_view rest = line.text;
+    DocumentRecord record;
+    record.id = ParseInt(NextField(rest, line.offset), line.offset);
+    if (record.id < 0) {
+        ThrowMalformed(line.offset, "negative id"sv);
+    }
+    record.status = ParseStatus(NextField(rest, line.offset), line.offset);
+    string_view ratings = NextField(rest, line.offset);
+    while (!ratings.empty()) {
+        const size_t space = min(ratings.find(' '), ratings.size());
+        if (space > 0) {
+            record.ratings.push_back(ParseInt(ratings.substr(0, space), line.offset));
+        }
+        ratings.remove_prefix(min(space + 1, ratings.size()));
+    }
+    // Checked here rather than by the server, which would not know the offset
+    if (rest.find('\t') != rest.npos) {
+        ThrowMalformed(line.offset, "expected 4 tab-separated fields"sv);
+    }
+    if (any_of(rest.begin(), rest.end(), [](char c) {
+            return c >= 0 && c < ' ';
+        })) {
+        ThrowMalformed(line.offset, "control character in text"sv);
+    }
+    record.text = rest;
+    return record;
+}
+
+// Lines of `chunk`, which starts at byte `chunk_offset` of the file
+vector<Line> SplitIntoLines(string_view chunk, size_t chunk_offset) {
+    vector<Line> lines;
+    size_t pos = 0;
+    while (pos < chunk.size()) {
+        const size_t end = min(chunk.find('\n', pos), chunk.size());
+        string_view text = chunk.substr(pos, end - pos);
+        if (!text.empty() && text.back() == '\r') {
+            text.remove_suffix(1);
+        }
+        if (!text.empty()) {
+            lines.push_back({text, chunk_offset + pos});
+        }
+        pos = end + 1;
+    }
+    return lines;
+}
+
+}  // namespace
+
+size_t LoadCorpus(SearchServer& search_server, const string& path) {
+    const MappedFile file(path);
+    const string_view content = file.GetContent();
+
+    size_t document_count = 0;
+    size_t chunk_begin = 0;
+    while (chunk_begin < content.size()) {
+        // Chunks end at line boundaries, a line longer than a chunk makes a chunk of its own
+        size_t chunk_end = min(chunk_begin + CHUNK_SIZE, content.size());
+        if (chunk_end < content.size()) {
+            const size_t newline = content.find('\n', chunk_end - 1);
+            chunk_end = newline == content.npos ? content.size() : newline + 1;
+        }
+
+        const vector<Line> lines = SplitIntoLines(content.substr(chunk_begin, chunk_end - chunk_begin), chunk_begin);
+        vector<DocumentRecord> records(lines.size());
+        // An exception must not escape a parallel algorithm, errors are rethrown afterwards
+        vector<exception_ptr> errors(lines.size());
+        for_each(execution::par, lines.begin(), lines.end(), [&lines, &records, &errors](const Line& line) {
+            const size_t index = &line - lines.data();
+            try {
+                records[index] = ParseLine(line);
+            } catch (...) {
+                errors[index] = current_exception();
+            }
+        });
+        // The first bad line is reported. Ids of earlier chunks are in the server already.
+        unordered_set<int> chunk_ids;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (errors[i]) {
+                rethrow_exception(errors[i]);
+            }
+            if (search_server.HasDocument(records[i].id) || !chunk_ids.insert(records[i].id).second) {
+                ThrowMalformed(lines[i].offset, "duplicate id"sv);
+            }
+        }
+        search_server.AddDocuments(execution::par, records);
+
+        document_count += records.size();
+        chunk_begin = chunk_end;
+    }
+    return document_count;
+}
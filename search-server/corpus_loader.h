@@ -0,0 +1,26 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <cstddef>
+#include <string>
+
+// Adds all documents of a corpus file to the server and returns their count.
+//
+// The file is a text file with one document per line and four tab-separated
+// fields:
+//
+//   id <TAB> status <TAB> ratings <TAB> text
+//
+// `id` is a non-negative integer, `status` is one of ACTUAL, IRRELEVANT, BANNED
+// or REMOVED, `ratings` is a space-separated list of integers (possibly empty)
+// and `text` is the document itself. Empty lines are skipped, a trailing '\r'
+// is ignored.
+//
+// The file is memory-mapped and parsed in place in chunks of several megabytes,
+// each chunk is parsed and tokenized in parallel and added with one
+// AddDocuments call. Throws std::invalid_argument with the byte offset of the
+// line if a line is malformed (including a negative id, control characters in
+// the text or an id already added) and std::runtime_error if the file can not
+// be read. Documents of the chunks before the malformed one stay added.
+size_t LoadCorpus(SearchServer& search_server, const std::string& path);
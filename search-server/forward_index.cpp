@@ -0,0 +1,78 @@
+#include "forward_index.h"
+#include <algorithm>
+
+using namespace std;
+
+void ForwardIndex::Add(int document_id, const vector<TermFrequency>& terms) {
+    Remove(document_id);
+    const size_t filter_offset = filters_.size();
+    const size_t filter_size = GetBloomBlockCount(terms.size(), FILTER_BITS_PER_TERM);
+    filters_.resize(filter_offset + filter_size);
+    for (const TermFrequency& record : terms) {
+        AddToBlocks(filters_.data() + filter_offset, filter_size, HashTermId(record.term));
+    }
+    extents_[document_id] = {records_.size(), terms.size(), filter_offset};
+    records_.insert(records_.end(), terms.begin(), terms.end());
+}
+
+TermFrequencies ForwardIndex::Get(int document_id) const {
+    const auto it = extents_.find(document_id);
+    if (it == extents_.end()) {
+        return {};
+    }
+    const TermFrequency* first = records_.data() + it->second.offset;
+    return {first, first + it->second.size};
+}
+
+TermFilter ForwardIndex::GetTermFilter(int document_id) const {
+    const auto it = extents_.find(document_id);
+    if (it == extents_.end()) {
+        return {};
+    }
+    return {filters_.data() + it->second.filter_offset, GetBloomBlockCount(it->second.size, FILTER_BITS_PER_TERM)};
+}
+
+void ForwardIndex::Remove(int document_id) {
+    const auto it = extents_.find(document_id);
+    if (it == extents_.end()) {
+        return;
+    }
+    garbage_size_ += it->second.size;
+    extents_.erase(it);
+    if (garbage_size_ > records_.size() / 2) {
+        Compact();
+    }
+}
+
+void ForwardIndex::Compact() {
+    // Runs are moved towards the front in offset order, so no run is overwritten before it is moved
+    vector<Extent*> extents;
+    extents.reserve(extents_.size());
+    for (auto& [document_id, extent] : extents_) {
+        extents.push_back(&extent);
+    }
+    sort(extents.begin(), extents.end(), [](const Extent* lhs, const Extent* rhs) {
+        return lhs->offset < rhs->offset;
+    });
+    // Filters are laid out in the same order as the records
+    size_t size = 0;
+    size_t filter_size = 0;
+    for (Extent* extent : extents) {
+        move(records_.begin() + extent->offset, records_.begin() + extent->offset + extent->size, records_.begin() + size);
+        extent->offset = size;
+        size += extent->size;
+        const size_t block_count = GetBloomBlockCount(extent->size, FILTER_BITS_PER_TERM);
+        move(filters_.begin() + extent->filter_offset, filters_.begin() + extent->filter_offset + block_count, filters_.begin() + filter_size);
+        extent->filter_offset = filter_size;
+        filter_size += block_count;
+    }
+    records_.resize(size);
+    records_.shrink_to_fit();
+    filters_.resize(filter_size);
+    filters_.shrink_to_fit();
+    garbage_size_ = 0;
+}
+
+MemoryUsage ForwardIndex::GetMemoryUsage() const {
+    return {GetVectorBytes(records_) + GetVectorBytes(filters_) + GetNodeMemoryUsage(extents_).bytes, records_.size() - garbage_size_};
+}
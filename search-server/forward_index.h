@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "bloom_filter.h"
+#include "memory_usage.h"
+#include "term_dictionary.h"
+
+struct TermFrequency {
+    TermId term;
+    double freq;
+};
+
+// Read-only view of a contiguous run of records
+template <typename T>
+class RecordSpan {
+public:
+    RecordSpan() = default;
+    RecordSpan(const T* begin, const T* end) : begin_(begin), end_(end) {}
+    const T* begin() const {
+        return begin_;
+    }
+    const T* end() const {
+        return end_;
+    }
+    size_t size() const {
+        return end_ - begin_;
+    }
+    bool empty() const {
+        return begin_ == end_;
+    }
+    const T& operator[](size_t index) const {
+        return begin_[index];
+    }
+private:
+    const T* begin_ = nullptr;
+    const T* end_ = nullptr;
+};
+
+using TermFrequencies = RecordSpan<TermFrequency>;
+
+// Term frequencies of a document presented as (word, frequency) pairs in term id order
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        // Pairs are made on dereference, so this is only an input iterator
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+
+        // Keeps the pair made by operator-> alive for the member access
+        class Pointer {
+        public:
+            explicit Pointer(value_type value) : value_(value) {}
+            const value_type* operator->() const {
+                return &value_;
+            }
+        private:
+            value_type value_;
+        };
+        using pointer = Pointer;
+
+        Iterator(const TermFrequency* record, const TermDictionary* terms) : record_(record), terms_(terms) {}
+        reference operator*() const {
+            return {terms_->GetWord(record_->term), record_->freq};
+        }
+        pointer operator->() const {
+            return Pointer(**this);
+        }
+        Iterator& operator++() {
+            ++record_;
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++record_;
+            return old;
+        }
+        bool operator==(const Iterator& other) const {
+            return record_ == other.record_;
+        }
+        bool operator!=(const Iterator& other) const {
+            return record_ != other.record_;
+        }
+    private:
+        const TermFrequency* record_;
+        const TermDictionary* terms_;
+    };
+
+    WordFrequencies(TermFrequencies records, const TermDictionary& terms) : records_(records), terms_(&terms) {}
+    Iterator begin() const {
+        return {records_.begin(), terms_};
+    }
+    Iterator end() const {
+        return {records_.end(), terms_};
+    }
+    size_t size() const {
+        return records_.size();
+    }
+    bool empty() const {
+        return records_.empty();
+    }
+private:
+    TermFrequencies records_;
+    const TermDictionary* terms_;
+};
+
+// Bloom filter of the terms of one document
+class TermFilter {
+public:
+    TermFilter() = default;
+    TermFilter(const uint64_t* blocks, size_t block_count) : blocks_(blocks), block_count_(block_count) {}
+
+    // False means the term is not in the document
+    bool MayContain(TermId term) const {
+        return BlocksMayContain(blocks_, block_count_, HashTermId(term));
+    }
+private:
+    const uint64_t* blocks_ = nullptr;
+    size_t block_count_ = 0;
+};
+
+// Term frequencies of all documents stored in one array, every document owns
+// a contiguous run of records sorted by term id. Runs of removed documents
+// become garbage that is squeezed out once it outweighs the live records.
+//
+// Every document also owns a run of a second array: a Bloom filter of its
+// terms sized to their count, which rules out about 97% of absent terms
+// without touching the records.
+class ForwardIndex {
+public:
+    ForwardIndex() = default;
+    ForwardIndex(const ForwardIndex&) = default;
+    ForwardIndex& operator=(const ForwardIndex&) = default;
+    // A moved-from index is empty
+    ForwardIndex(ForwardIndex&& other) noexcept
+        : records_(std::move(other.records_))
+        , filters_(std::move(other.filters_))
+        , extents_(std::move(other.extents_))
+        , garbage_size_(std::exchange(other.garbage_size_, 0)) {
+    }
+    ForwardIndex& operator=(ForwardIndex&& other) noexcept {
+        records_ = std::move(other.records_);
+        filters_ = std::move(other.filters_);
+        extents_ = std::move(other.extents_);
+        garbage_size_ = std::exchange(other.garbage_size_, 0);
+        return *this;
+    }
+
+    // `terms` must be sorted by term id without repetitions
+    void Add(int document_id, const std::vector<TermFrequency>& terms);
+
+    // Returns an empty span for unknown documents. Spans are invalidated by Add and Remove.
+    TermFrequencies Get(int document_id) const;
+
+    // Rejects every term for unknown documents. Filters are invalidated by Add and Remove.
+    TermFilter GetTermFilter(int document_id) const;
+
+    void Remove(int document_id);
+
+    // Squeezes out the records of removed documents and releases slack capacity
+    void Compact();
+
+    // Entries are the records of live documents
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    static constexpr size_t FILTER_BITS_PER_TERM = 8;
+
+    struct Extent {
+        size_t offset;
+        size_t size;
+        // The filter has GetBloomBlockCount(size, FILTER_BITS_PER_TERM) blocks
+        size_t filter_offset;
+    };
+
+    std::vector<TermFrequency> records_;
+    std::vector<uint64_t> filters_;
+    CountedMap<int, Extent> extents_;
+    size_t garbage_size_ = 0;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count);
+
+// Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent,
+// so a few words of the dictionary dominate the text like in a natural language
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t n, double exponent);
+
+    size_t operator()(std::mt19937& generator) const;
+
+private:
+    std::vector<double> cumulative_;
+};
+
+std::string GenerateZipfQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, const ZipfDistribution& distribution,
+                              int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateZipfQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, const ZipfDistribution& distribution,
+                                             int query_count, int max_word_count, double minus_prob = 0);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+
+struct IdentityKey {
+    template <typename T>
+    const T& operator()(const T& value) const {
+        return value;
+    }
+};
+
+// Returns the first position in [first, last) whose key is not less than `key`.
+// Probes 1, 2, 4, ... elements ahead before the binary search, so the cost
+// depends on the distance to the answer rather than on the range length.
+template <typename It, typename T, typename Key = IdentityKey>
+It GallopLowerBound(It first, It last, const T& key, Key get_key = {}) {
+    auto length = std::distance(first, last);
+    decltype(length) step = 1;
+    while (step < length && get_key(*std::next(first, step)) < key) {
+        first = std::next(first, step);
+        length -= step;
+        step *= 2;
+    }
+    return std::lower_bound(first, std::next(first, std::min(step + 1, length)), key,
+                            [&get_key](const auto& element, const T& value) {
+                                return get_key(element) < value;
+                            });
+}
+
+// Walks the first range and gallops through the second one
+template <typename WalkIt, typename SearchIt, typename Func, typename WalkKey, typename SearchKey>
+void IntersectSortedWalking(WalkIt walk_first, WalkIt walk_last, SearchIt search_first, SearchIt search_last, Func on_match,
+                            WalkKey walk_key, SearchKey search_key) {
+    for (; walk_first != walk_last && search_first != search_last; ++walk_first) {
+        const auto& key = walk_key(*walk_first);
+        search_first = GallopLowerBound(search_first, search_last, key, search_key);
+        if (search_first != search_last && !(key < search_key(*search_first))) {
+            on_match(walk_first, search_first);
+        }
+    }
+}
+
+// Calls on_match(lhs_it, rhs_it) for every key present in both sorted ranges.
+// The shorter range is walked and the longer one is searched by galloping.
+template <typename LhsIt, typename RhsIt, typename Func, typename LhsKey = IdentityKey, typename RhsKey = IdentityKey>
+void IntersectSorted(LhsIt lhs_first, LhsIt lhs_last, RhsIt rhs_first, RhsIt rhs_last, Func on_match,
+                     LhsKey lhs_key = {}, RhsKey rhs_key = {}) {
+    if (std::distance(lhs_first, lhs_last) <= std::distance(rhs_first, rhs_last)) {
+        IntersectSortedWalking(lhs_first, lhs_last, rhs_first, rhs_last, on_match, lhs_key, rhs_key);
+    } else {
+        IntersectSortedWalking(rhs_first, rhs_last, lhs_first, lhs_last,
+                               [&on_match](RhsIt rhs, LhsIt lhs) { on_match(lhs, rhs); }, rhs_key, lhs_key);
+    }
+}
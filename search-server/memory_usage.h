@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct MemoryUsage {
+    size_t bytes = 0;
+    size_t entries = 0;
+};
+
+// Allocator that counts the bytes a container holds, including the nodes of
+// maps and sets whose size is otherwise unknown. Rebound copies share the
+// counter. A copied container gets its own counter, a moved-from container
+// starts a new one on its next allocation.
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    CountingAllocator()
+        : bytes_(std::make_shared<std::atomic<size_t>>(0)) {
+    }
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : bytes_(other.bytes_) {
+    }
+
+    T* allocate(size_t count) {
+        // Moving leaves the source without a counter
+        if (!bytes_) {
+            bytes_ = std::make_shared<std::atomic<size_t>>(0);
+        }
+        T* result = std::allocator<T>().allocate(count);
+        bytes_->fetch_add(count * sizeof(T), std::memory_order_relaxed);
+        return result;
+    }
+
+    void deallocate(T* pointer, size_t count) noexcept {
+        if (bytes_) {
+            bytes_->fetch_sub(count * sizeof(T), std::memory_order_relaxed);
+        }
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    CountingAllocator select_on_container_copy_construction() const {
+        return {};
+    }
+
+    size_t GetAllocatedBytes() const {
+        return bytes_ ? bytes_->load(std::memory_order_relaxed) : 0;
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>& other) const {
+        return bytes_ == other.bytes_;
+    }
+
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>& other) const {
+        return bytes_ != other.bytes_;
+    }
+
+private:
+    template <typename U>
+    friend class CountingAllocator;
+
+    std::shared_ptr<std::atomic<size_t>> bytes_;
+};
+
+template <typename Key, typename Value, typename Compare = std::less<Key>>
+using CountedMap = std::map<Key, Value, Compare, CountingAllocator<std::pair<const Key, Value>>>;
+
+template <typename Key, typename Compare = std::less<Key>>
+using CountedSet = std::set<Key, Compare, CountingAllocator<Key>>;
+
+template <typename Container>
+MemoryUsage GetNodeMemoryUsage(const Container& container) {
+    return {container.get_allocator().GetAllocatedBytes(), container.size()};
+}
+
+template <typename T>
+size_t GetVectorBytes(const std::vector<T>& values) {
+    return values.capacity() * sizeof(T);
+}
+
+inline size_t GetVectorBytes(const std::vector<bool>& values) {
+    return (values.capacity() + 7) / 8;
+}
+
+// Heap bytes of a string, zero if it fits into the string object itself
+inline size_t GetHeapBytes(const std::string& value) {
+    const char* const object = reinterpret_cast<const char*>(&value);
+    const bool is_local = value.data() >= object && value.data() < object + sizeof(value);
+    return is_local ? 0 : value.capacity() + 1;
+}
@@ -0,0 +1,200 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(MetricStage::COUNT);
+
+int Log2(uint64_t value) {
+    int result = 0;
+    while (value >>= 1) {
+        ++result;
+    }
+    return result;
+}
+
+// Only the owning thread writes a counter, so no read-modify-write is needed
+void Increase(atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+}  // namespace
+
+string_view GetMetricStageName(MetricStage stage) {
+    switch (stage) {
+        case MetricStage::PARSE: return "parse"sv;
+        case MetricStage::POSTING_TRAVERSAL: return "posting_traversal"sv;
+        case MetricStage::SCORING: return "scoring"sv;
+        case MetricStage::TOP_K_SORT: return "top_k_sort"sv;
+        case MetricStage::MATCH: return "match"sv;
+        case MetricStage::ADD: return "add"sv;
+        case MetricStage::REMOVE: return "remove"sv;
+        default: return "unknown"sv;
+    }
+}
+
+int HistogramLayout::GetBucket(uint64_t value_ns) {
+    if (value_ns < SUB_BUCKET_COUNT) {
+        return static_cast<int>(value_ns);
+    }
+    const int octave = min(Log2(value_ns) - SUB_BUCKET_BITS, OCTAVE_COUNT - 1);
+    const uint64_t sub_bucket = min<uint64_t>((value_ns >> octave) - SUB_BUCKET_COUNT, SUB_BUCKET_COUNT - 1);
+    return SUB_BUCKET_COUNT * (octave + 1) + static_cast<int>(sub_bucket);
+}
+
+uint64_t HistogramLayout::GetUpperBound(int bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const int octave = bucket / SUB_BUCKET_COUNT - 1;
+    const uint64_t sub_bucket = bucket % SUB_BUCKET_COUNT;
+    return ((SUB_BUCKET_COUNT + sub_bucket + 1) << octave) - 1;
+}
+
+uint64_t HistogramSnapshot::GetQuantile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(quantile * count + 0.5));
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < HistogramLayout::BUCKET_COUNT; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return HistogramLayout::GetUpperBound(bucket);
+        }
+    }
+    return HistogramLayout::GetUpperBound(HistogramLayout::BUCKET_COUNT - 1);
+}
+
+struct MetricsRegistry::ThreadMetrics {
+    array<array<atomic<uint64_t>, HistogramLayout::BUCKET_COUNT>, STAGE_COUNT> buckets = {};
+    array<atomic<uint64_t>, STAGE_COUNT> sum_ns = {};
+
+    void AddTo(MetricsSnapshot& snapshot) const {
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            HistogramSnapshot& histogram = snapshot.stages[stage];
+            for (int bucket = 0; bucket < HistogramLayout::BUCKET_COUNT; ++bucket) {
+                const uint64_t value = buckets[stage][bucket].load(memory_order_relaxed);
+                histogram.buckets[bucket] += value;
+                histogram.count += value;
+            }
+            histogram.sum_ns += sum_ns[stage].load(memory_order_relaxed);
+        }
+    }
+};
+
+// Registers the calling thread's counters on first use and folds them into
+// the retired totals when the thread exits
+class MetricsRegistry::ThreadSlot {
+public:
+    ThreadSlot() {
+        MetricsRegistry& registry = Instance();
+        lock_guard guard(registry.mutex_);
+        registry.threads_.push_back(&metrics_);
+    }
+
+    ~ThreadSlot() {
+        MetricsRegistry& registry = Instance();
+        lock_guard guard(registry.mutex_);
+        metrics_.AddTo(registry.retired_);
+        registry.threads_.erase(find(registry.threads_.begin(), registry.threads_.end(), &metrics_));
+    }
+
+    ThreadMetrics& Get() {
+        return metrics_;
+    }
+
+private:
+    ThreadMetrics metrics_;
+};
+
+MetricsRegistry& MetricsRegistry::Instance() {
+    // Never destroyed: worker threads may exit after static destructors have run
+    static MetricsRegistry* const registry = new MetricsRegistry;
+    return *registry;
+}
+
+MetricsRegistry::ThreadMetrics& MetricsRegistry::GetThreadMetrics() {
+    static thread_local ThreadSlot slot;
+    return slot.Get();
+}
+
+void MetricsRegistry::Record(MetricStage stage, uint64_t duration_ns) {
+    ThreadMetrics& metrics = GetThreadMetrics();
+    const size_t index = static_cast<size_t>(stage);
+    Increase(metrics.buckets[index][HistogramLayout::GetBucket(duration_ns)], 1);
+    Increase(metrics.sum_ns[index], duration_ns);
+}
+
+MetricsSnapshot MetricsRegistry::Snapshot() const {
+    lock_guard guard(mutex_);
+    MetricsSnapshot snapshot = retired_;
+    for (const ThreadMetrics* thread : threads_) {
+        thread->AddTo(snapshot);
+    }
+    return snapshot;
+}
+
+void WritePrometheus(ostream& out, const MetricsSnapshot& snapshot) {
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << setprecision(9);
+
+    out << "# HELP search_server_stage_duration_seconds Time spent in a search server stage.\n"sv;
+    out << "# TYPE search_server_stage_duration_seconds histogram\n"sv;
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        const string_view name = GetMetricStageName(static_cast<MetricStage>(stage));
+        const HistogramSnapshot& histogram = snapshot.stages[stage];
+        uint64_t cumulative = 0;
+        for (int bucket = 0; bucket < HistogramLayout::BUCKET_COUNT; ++bucket) {
+            cumulative += histogram.buckets[bucket];
+            // Only octave boundaries are exported to keep the series count small
+            if ((bucket + 1) % HistogramLayout::SUB_BUCKET_COUNT == 0) {
+                out << "search_server_stage_duration_seconds_bucket{stage=\""sv << name << "\",le=\""sv
+                    << (HistogramLayout::GetUpperBound(bucket) + 1) * 1e-9 << "\"} "sv << cumulative << '\n';
+            }
+        }
+        out << "search_server_stage_duration_seconds_bucket{stage=\""sv << name << "\",le=\"+Inf\"} "sv << histogram.count << '\n';
+        out << "search_server_stage_duration_seconds_sum{stage=\""sv << name << "\"} "sv << histogram.sum_ns * 1e-9 << '\n';
+        out << "search_server_stage_duration_seconds_count{stage=\""sv << name << "\"} "sv << histogram.count << '\n';
+    }
+
+    out << "# HELP search_server_stage_duration_quantile_seconds Latency quantiles of a search server stage.\n"sv;
+    out << "# TYPE search_server_stage_duration_quantile_seconds gauge\n"sv;
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        const string_view name = GetMetricStageName(static_cast<MetricStage>(stage));
+        const HistogramSnapshot& histogram = snapshot.stages[stage];
+        for (const double quantile : {0.5, 0.99}) {
+            out << "search_server_stage_duration_quantile_seconds{stage=\""sv << name << "\",quantile=\""sv << quantile << "\"} "sv
+                << histogram.GetQuantile(quantile) * 1e-9 << '\n';
+        }
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void WritePrometheus(ostream& out) {
+    WritePrometheus(out, MetricsRegistry::Instance().Snapshot());
+}
+
+bool WritePrometheusFile(const string& path) {
+    // Write to a temporary file first so a scraper never sees a partial snapshot
+    const string temporary_path = path + ".tmp"s;
+    {
+        ofstream out(temporary_path);
+        if (!out) {
+            return false;
+        }
+        WritePrometheus(out);
+        if (!out) {
+            return false;
+        }
+    }
+    return rename(temporary_path.c_str(), path.c_str()) == 0;
+}
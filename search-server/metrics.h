@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define METRICS_CONCAT_INTERNAL(X, Y) X##Y
+#define METRICS_CONCAT(X, Y) METRICS_CONCAT_INTERNAL(X, Y)
+#define UNIQUE_VAR_NAME_METRICS METRICS_CONCAT(metricsGuard, __LINE__)
+
+/**
+ * Measures the time from its call to the end of the enclosing block and adds it
+ * to the histogram of the given stage. Expands to nothing unless the code is
+ * compiled with SEARCH_SERVER_METRICS defined.
+ *
+ * Example:
+ *
+ *  void SearchServer::AddDocument(...) {
+ *      METRICS_SCOPE(MetricStage::ADD);
+ *      ...
+ *  }
+ */
+#ifdef SEARCH_SERVER_METRICS
+#define METRICS_SCOPE(stage) ScopedTimer UNIQUE_VAR_NAME_METRICS(stage)
+#else
+#define METRICS_SCOPE(stage)
+#endif
+
+enum class MetricStage {
+    PARSE,
+    POSTING_TRAVERSAL,
+    SCORING,
+    TOP_K_SORT,
+    MATCH,
+    ADD,
+    REMOVE,
+    COUNT,
+};
+
+std::string_view GetMetricStageName(MetricStage stage);
+
+// Log-linear latency histogram layout: values below 2^SUB_BUCKET_BITS nanoseconds
+// are counted exactly, every further power of two is split into 2^SUB_BUCKET_BITS
+// linear sub-buckets (relative error below 12.5%)
+struct HistogramLayout {
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static constexpr int OCTAVE_COUNT = 45;
+    static constexpr int BUCKET_COUNT = SUB_BUCKET_COUNT * (OCTAVE_COUNT + 1);
+
+    static int GetBucket(uint64_t value_ns);
+    // Largest value in nanoseconds that falls into the bucket
+    static uint64_t GetUpperBound(int bucket);
+};
+
+struct HistogramSnapshot {
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(HistogramLayout::BUCKET_COUNT);
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+
+    // Upper bound of the bucket containing the given quantile, in nanoseconds
+    uint64_t GetQuantile(double quantile) const;
+};
+
+struct MetricsSnapshot {
+    std::array<HistogramSnapshot, static_cast<size_t>(MetricStage::COUNT)> stages;
+
+    const HistogramSnapshot& operator[](MetricStage stage) const {
+        return stages[static_cast<size_t>(stage)];
+    }
+};
+
+// Every thread writes only into its own block of counters, so recording is
+// a couple of relaxed loads and stores without locks or contended cache lines.
+// The registry mutex is taken only when a thread records for the first time,
+// when it exits and when a snapshot is taken.
+class MetricsRegistry {
+public:
+    static MetricsRegistry& Instance();
+
+    void Record(MetricStage stage, uint64_t duration_ns);
+
+    MetricsSnapshot Snapshot() const;
+
+private:
+    struct ThreadMetrics;
+    class ThreadSlot;
+
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    static ThreadMetrics& GetThreadMetrics();
+
+    mutable std::mutex mutex_;
+    std::vector<const ThreadMetrics*> threads_;
+    // Counts of threads that have already exited
+    MetricsSnapshot retired_;
+};
+
+class ScopedTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ScopedTimer(MetricStage stage)
+        : stage_(stage) {
+    }
+
+    ~ScopedTimer() {
+        const auto duration = Clock::now() - start_time_;
+        MetricsRegistry::Instance().Record(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+private:
+    const MetricStage stage_;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+// Writes the snapshot in Prometheus text exposition format: a histogram with
+// one bucket per power of two and p50/p99 gauges for every stage
+void WritePrometheus(std::ostream& out, const MetricsSnapshot& snapshot);
+
+void WritePrometheus(std::ostream& out);
+
+// Returns false if the file could not be written
+bool WritePrometheusFile(const std::string& path);
@@ -1,7 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
-#include <cmath>
+#include <iterator>
 #include <vector>
 #include <string>
 
@@ -15,42 +16,78 @@ public:
     auto end() const {
         return it_end_;
     }
-    size_t size() {
-        return distance(it_begin_, it_end_);
+    size_t size() const {
+        return std::distance(it_begin_, it_end_);
     }
 private:
     It it_begin_;
     It it_end_;
 };
 
+// Lazy view over a range: page boundaries are computed on demand,
+// nothing is materialized up front.
 template <typename It>
 class Paginator {
 public:
-    Paginator(It begin_, It end_, size_t size_) {
-        size_t count = 0;
-        It begin = begin_;
-        for (auto i = begin_; i != end_; ++i) {
-            if(count == size_) {
-                pages.push_back({begin, i-1});
-                begin = i;
-                count = 0;
-            } else {
-                count++;
-            }
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<It>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<It>;
+
+        PageIterator(const Paginator* paginator, size_t page) : paginator_(paginator), page_(page) {}
+
+        IteratorRange<It> operator*() const {
+            return paginator_->GetPage(page_);
+        }
+        PageIterator& operator++() {
+            ++page_;
+            return *this;
+        }
+        PageIterator operator++(int) {
+            PageIterator old = *this;
+            ++page_;
+            return old;
+        }
+        bool operator==(const PageIterator& other) const {
+            return page_ == other.page_;
         }
-        pages.push_back({begin, end_-1});
+        bool operator!=(const PageIterator& other) const {
+            return page_ != other.page_;
+        }
+    private:
+        const Paginator* paginator_;
+        size_t page_;
+    };
+
+    Paginator(It range_begin, It range_end, size_t page_size)
+        : begin_(range_begin)
+        , item_count_(std::distance(range_begin, range_end))
+        , page_size_(std::max<size_t>(page_size, 1)) {
+    }
+    IteratorRange<It> GetPage(size_t page) const {
+        const size_t first = std::min(page * page_size_, item_count_);
+        const size_t last = std::min(first + page_size_, item_count_);
+        return {std::next(begin_, first), std::next(begin_, last)};
+    }
+    IteratorRange<It> operator[](size_t page) const {
+        return GetPage(page);
     }
     auto begin() const {
-        return pages.begin();
+        return PageIterator(this, 0);
     }
     auto end() const {
-        return pages.end();
+        return PageIterator(this, size());
     }
-    size_t size() {
-        return distance(pages.begin(), pages.end());
+    size_t size() const {
+        return (item_count_ + page_size_ - 1) / page_size_;
     }
 private:
-    std::vector<IteratorRange<It>> pages;
+    It begin_;
+    size_t item_count_;
+    size_t page_size_;
 };
 
 template <typename Container>
@@ -60,7 +97,7 @@ auto Paginate(const Container& c, size_t page_size) {
 
 template<typename It>
 std::ostream& operator<<(std::ostream& out, IteratorRange<It> doc) {
-    for (auto it = doc.begin(); it != doc.end() + 1; it++)
+    for (auto it = doc.begin(); it != doc.end(); it++)
     {
         out << *it;
     }
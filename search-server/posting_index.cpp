@@ -0,0 +1,387 @@
+#include "posting_index.h"
+
+#include <chrono>
+#include <limits>
+#include <numeric>
+
+using namespace std;
+
+PostingIndex::PostingIndex(const PostingIndex& other)
+    : slots_(other.slots_)
+    , buffer_(other.buffer_)
+    , buffer_documents_(other.buffer_documents_)
+    , document_freqs_(other.document_freqs_) {
+}
+
+PostingIndex& PostingIndex::operator=(const PostingIndex& other) {
+    if (this != &other) {
+        // The running merge belongs to the old segments, its result is dropped
+        pending_ = PendingMerge();
+        slots_ = other.slots_;
+        buffer_ = other.buffer_;
+        buffer_documents_ = other.buffer_documents_;
+        document_freqs_ = other.document_freqs_;
+    }
+    return *this;
+}
+
+pair<uint32_t, uint32_t> PostingIndex::Segment::FindPostings(TermId term) const {
+    const auto it = lower_bound(terms.begin(), terms.end(), term);
+    if (it == terms.end() || *it != term) {
+        return {0, 0};
+    }
+    const size_t index = it - terms.begin();
+    return {offsets[index], offsets[index + 1]};
+}
+
+uint32_t PostingIndex::Segment::FindOrdinal(int document_id) const {
+    if (ordinals_by_id.empty()) {
+        const auto it = lower_bound(document_ids.begin(), document_ids.end(), document_id);
+        return it != document_ids.end() && *it == document_id ? static_cast<uint32_t>(it - document_ids.begin()) : NO_ORDINAL;
+    }
+    const auto it = lower_bound(ordinals_by_id.begin(), ordinals_by_id.end(), document_id, [this](uint32_t ordinal, int id) {
+        return document_ids[ordinal] < id;
+    });
+    return it != ordinals_by_id.end() && document_ids[*it] == document_id ? *it : NO_ORDINAL;
+}
+
+void PostingIndex::Add(int document_id, TermFrequencies terms) {
+    UpdateMerges(false);
+    for (const auto [term, term_freq] : terms) {
+        buffer_.emplace(std::pair{term, document_id}, term_freq);
+        if (term >= document_freqs_.size()) {
+            document_freqs_.resize(term + 1);
+        }
+        ++document_freqs_[term];
+    }
+    buffer_documents_.insert(document_id);
+    if (buffer_documents_.size() >= BUFFER_DOCUMENT_COUNT) {
+        FreezeBuffer();
+        StartMerge();
+    }
+}
+
+void PostingIndex::Remove(int document_id, TermFrequencies terms) {
+    UpdateMerges(false);
+    for (const TermFrequency& record : terms) {
+        --document_freqs_[record.term];
+    }
+    if (buffer_documents_.erase(document_id)) {
+        for (const TermFrequency& record : terms) {
+            buffer_.erase({record.term, document_id});
+        }
+        return;
+    }
+    for (SegmentSlot& slot : slots_) {
+        const uint32_t ordinal = slot.segment->FindOrdinal(document_id);
+        if (ordinal != NO_ORDINAL && !slot.deleted[ordinal]) {
+            slot.deleted[ordinal] = true;
+            --slot.live_count;
+            break;
+        }
+    }
+    StartMerge();
+}
+
+void PostingIndex::Flush() {
+    if (!buffer_documents_.empty()) {
+        FreezeBuffer();
+    }
+    do {
+        UpdateMerges(true);
+    } while (pending_.result.valid());
+}
+
+void PostingIndex::FreezeBuffer() {
+    auto segment = make_shared<Segment>();
+    segment->document_ids.assign(buffer_documents_.begin(), buffer_documents_.end());
+    segment->ordinals.reserve(buffer_.size());
+    segment->freqs.reserve(buffer_.size());
+    segment->offsets.push_back(0);
+    auto id_it = segment->document_ids.begin();
+    for (const auto& [key, term_freq] : buffer_) {
+        const auto [term, document_id] = key;
+        if (segment->terms.empty() || segment->terms.back() != term) {
+            if (!segment->terms.empty()) {
+                segment->offsets.push_back(static_cast<uint32_t>(segment->ordinals.size()));
+            }
+            segment->terms.push_back(term);
+            id_it = segment->document_ids.begin();
+        }
+        // Postings of a term are in id order, so ordinals can be found by a forward search
+        id_it = lower_bound(id_it, segment->document_ids.end(), document_id);
+        segment->ordinals.push_back(static_cast<uint32_t>(id_it - segment->document_ids.begin()));
+        segment->freqs.push_back(term_freq);
+    }
+    if (!segment->terms.empty()) {
+        segment->offsets.push_back(static_cast<uint32_t>(segment->ordinals.size()));
+    }
+
+    SegmentSlot slot;
+    slot.live_count = segment->document_ids.size();
+    slot.deleted.assign(slot.live_count, false);
+    slot.segment = move(segment);
+    slots_.push_back(move(slot));
+    buffer_.clear();
+    buffer_documents_.clear();
+}
+
+void PostingIndex::UpdateMerges(bool wait) {
+    if (!pending_.result.valid()) {
+        return;
+    }
+    if (!wait && pending_.result.wait_for(chrono::seconds(0)) != future_status::ready) {
+        return;
+    }
+    InstallMerge();
+    StartMerge();
+}
+
+void PostingIndex::InstallMerge() {
+    PendingMerge merge = move(pending_);
+    pending_ = PendingMerge();
+    // Inputs are adjacent: only merges remove slots and only freezing appends them
+    const auto first = find_if(slots_.begin(), slots_.end(), [&merge](const SegmentSlot& slot) {
+        return slot.segment == merge.inputs.front();
+    });
+    ReplaceSlots(first, first + merge.inputs.size(), merge.result.get(), merge.deleted);
+}
+
+void PostingIndex::ReplaceSlots(vector<SegmentSlot>::iterator first, vector<SegmentSlot>::iterator last,
+                                shared_ptr<const Segment> merged, const vector<vector<bool>>& deleted) {
+    SegmentSlot slot;
+    slot.live_count = merged->document_ids.size();
+    slot.deleted.assign(slot.live_count, false);
+    // Documents removed while the merge was running must be removed from its result too
+    for (auto old_slot = first; old_slot != last; ++old_slot) {
+        const vector<bool>& old_deleted = deleted[old_slot - first];
+        for (size_t ordinal = 0; ordinal < old_slot->deleted.size(); ++ordinal) {
+            if (old_slot->deleted[ordinal] && !old_deleted[ordinal]) {
+                const int document_id = old_slot->segment->document_ids[ordinal];
+                slot.deleted[merged->FindOrdinal(document_id)] = true;
+                --slot.live_count;
+            }
+        }
+    }
+    slot.segment = move(merged);
+
+    const auto position = slots_.erase(first, last);
+    if (slot.live_count > 0) {
+        slots_.insert(position, move(slot));
+    }
+}
+
+void PostingIndex::Compact() {
+    Flush();
+    const bool has_tombstones = any_of(slots_.begin(), slots_.end(), [](const SegmentSlot& slot) {
+        return slot.live_count < slot.deleted.size();
+    });
+    if (slots_.size() > 1 || has_tombstones) {
+        vector<shared_ptr<const Segment>> inputs;
+        vector<vector<bool>> deleted;
+        for (const SegmentSlot& slot : slots_) {
+            inputs.push_back(slot.segment);
+            deleted.push_back(slot.deleted);
+        }
+        ReplaceSlots(slots_.begin(), slots_.end(), MergeSegments(inputs, deleted), deleted);
+    }
+    if (!slots_.empty()) {
+        slots_.front().segment = ReorderForLocality(*slots_.front().segment);
+    }
+    slots_.shrink_to_fit();
+    document_freqs_.shrink_to_fit();
+}
+
+MemoryUsage PostingIndex::GetMemoryUsage() const {
+    MemoryUsage usage = GetNodeMemoryUsage(buffer_);
+    usage.bytes += GetNodeMemoryUsage(buffer_documents_).bytes + GetVectorBytes(document_freqs_) + GetVectorBytes(slots_);
+    for (const SegmentSlot& slot : slots_) {
+        const Segment& segment = *slot.segment;
+        usage.bytes += sizeof(Segment) + GetVectorBytes(segment.document_ids) + GetVectorBytes(segment.ordinals_by_id)
+            + GetVectorBytes(segment.terms)
+            + GetVectorBytes(segment.offsets) + GetVectorBytes(segment.ordinals) + GetVectorBytes(segment.freqs)
+            + GetVectorBytes(slot.deleted);
+        usage.entries += segment.ordinals.size();
+    }
+    return usage;
+}
+
+void PostingIndex::StartMerge() {
+    if (pending_.result.valid() || slots_.empty()) {
+        return;
+    }
+    // Segments without live documents need no merge
+    slots_.erase(remove_if(slots_.begin(), slots_.end(), [](const SegmentSlot& slot) {
+        return slot.live_count == 0;
+    }), slots_.end());
+
+    // The newest segments are merged while each older one is at most twice as
+    // large as the newer ones together, so segment sizes grow geometrically
+    size_t first = slots_.size();
+    size_t newer_live_count = 0;
+    while (first > 0 && (first == slots_.size() || slots_[first - 1].live_count <= 2 * newer_live_count)) {
+        --first;
+        newer_live_count += slots_[first].live_count;
+    }
+    size_t last = slots_.size();
+    if (last - first < 2) {
+        // Otherwise a segment that is mostly tombstones is rewritten on its own
+        const auto sparse = find_if(slots_.begin(), slots_.end(), [](const SegmentSlot& slot) {
+            return slot.live_count * 2 < slot.deleted.size();
+        });
+        if (sparse == slots_.end()) {
+            return;
+        }
+        first = sparse - slots_.begin();
+        last = first + 1;
+    }
+
+    for (size_t i = first; i < last; ++i) {
+        pending_.inputs.push_back(slots_[i].segment);
+        pending_.deleted.push_back(slots_[i].deleted);
+    }
+    pending_.result = async(launch::async, MergeSegments, pending_.inputs, pending_.deleted);
+}
+
+shared_ptr<const PostingIndex::Segment> PostingIndex::MergeSegments(const vector<shared_ptr<const Segment>>& inputs,
+                                                                    const vector<vector<bool>>& deleted) {
+    auto merged = make_shared<Segment>();
+
+    // A live document is in exactly one input
+    for (size_t input = 0; input < inputs.size(); ++input) {
+        for (size_t ordinal = 0; ordinal < inputs[input]->document_ids.size(); ++ordinal) {
+            if (!deleted[input][ordinal]) {
+                merged->document_ids.push_back(inputs[input]->document_ids[ordinal]);
+            }
+        }
+    }
+    sort(merged->document_ids.begin(), merged->document_ids.end());
+
+    vector<vector<uint32_t>> new_ordinals(inputs.size());
+    for (size_t input = 0; input < inputs.size(); ++input) {
+        const vector<int>& document_ids = inputs[input]->document_ids;
+        new_ordinals[input].resize(document_ids.size(), NO_ORDINAL);
+        for (size_t ordinal = 0; ordinal < document_ids.size(); ++ordinal) {
+            if (!deleted[input][ordinal]) {
+                new_ordinals[input][ordinal] = merged->FindOrdinal(document_ids[ordinal]);
+            }
+        }
+    }
+
+    vector<TermId> terms;
+    for (const auto& input : inputs) {
+        terms.insert(terms.end(), input->terms.begin(), input->terms.end());
+    }
+    sort(terms.begin(), terms.end());
+    terms.erase(unique(terms.begin(), terms.end()), terms.end());
+
+    merged->offsets.push_back(0);
+    vector<pair<uint32_t, double>> postings;
+    for (const TermId term : terms) {
+        postings.clear();
+        for (size_t input = 0; input < inputs.size(); ++input) {
+            const auto [first, last] = inputs[input]->FindPostings(term);
+            for (uint32_t i = first; i < last; ++i) {
+                const uint32_t ordinal = new_ordinals[input][inputs[input]->ordinals[i]];
+                if (ordinal != NO_ORDINAL) {
+                    postings.push_back({ordinal, inputs[input]->freqs[i]});
+                }
+            }
+        }
+        if (postings.empty()) {
+            continue;
+        }
+        sort(postings.begin(), postings.end());
+        merged->terms.push_back(term);
+        for (const auto& [ordinal, term_freq] : postings) {
+            merged->ordinals.push_back(ordinal);
+            merged->freqs.push_back(term_freq);
+        }
+        merged->offsets.push_back(static_cast<uint32_t>(merged->ordinals.size()));
+    }
+
+    merged->document_ids.shrink_to_fit();
+    merged->terms.shrink_to_fit();
+    merged->offsets.shrink_to_fit();
+    merged->ordinals.shrink_to_fit();
+    merged->freqs.shrink_to_fit();
+    return merged;
+}
+
+shared_ptr<const PostingIndex::Segment> PostingIndex::ReorderForLocality(const Segment& segment) {
+    const size_t document_count = segment.document_ids.size();
+
+    // Rank 0 is the term with the longest postings in the segment
+    vector<uint32_t> term_indices(segment.terms.size());
+    iota(term_indices.begin(), term_indices.end(), 0);
+    const auto get_length = [&segment](uint32_t index) {
+        return segment.offsets[index + 1] - segment.offsets[index];
+    };
+    stable_sort(term_indices.begin(), term_indices.end(), [&get_length](uint32_t lhs, uint32_t rhs) {
+        return get_length(lhs) > get_length(rhs);
+    });
+    vector<uint32_t> term_ranks(segment.terms.size());
+    for (uint32_t rank = 0; rank < term_indices.size(); ++rank) {
+        term_ranks[term_indices[rank]] = rank;
+    }
+
+    // Ranks of the terms of every document, [rank_offsets[ordinal], rank_offsets[ordinal + 1])
+    vector<uint32_t> rank_offsets(document_count + 1);
+    for (const uint32_t ordinal : segment.ordinals) {
+        ++rank_offsets[ordinal + 1];
+    }
+    partial_sum(rank_offsets.begin(), rank_offsets.end(), rank_offsets.begin());
+    vector<uint32_t> ranks(segment.ordinals.size());
+    vector<uint32_t> fill = rank_offsets;
+    for (uint32_t index = 0; index < segment.terms.size(); ++index) {
+        for (uint32_t i = segment.offsets[index]; i < segment.offsets[index + 1]; ++i) {
+            ranks[fill[segment.ordinals[i]]++] = term_ranks[index];
+        }
+    }
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        sort(ranks.begin() + rank_offsets[ordinal], ranks.begin() + rank_offsets[ordinal + 1]);
+    }
+
+    vector<uint32_t> order(document_count);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+        const bool is_less = lexicographical_compare(ranks.begin() + rank_offsets[lhs], ranks.begin() + rank_offsets[lhs + 1],
+                                                     ranks.begin() + rank_offsets[rhs], ranks.begin() + rank_offsets[rhs + 1]);
+        const bool is_greater = lexicographical_compare(ranks.begin() + rank_offsets[rhs], ranks.begin() + rank_offsets[rhs + 1],
+                                                        ranks.begin() + rank_offsets[lhs], ranks.begin() + rank_offsets[lhs + 1]);
+        return is_less || (!is_greater && segment.document_ids[lhs] < segment.document_ids[rhs]);
+    });
+    vector<uint32_t> new_ordinals(document_count);
+    for (uint32_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        new_ordinals[order[ordinal]] = ordinal;
+    }
+
+    auto reordered = make_shared<Segment>();
+    reordered->document_ids.reserve(document_count);
+    for (const uint32_t old_ordinal : order) {
+        reordered->document_ids.push_back(segment.document_ids[old_ordinal]);
+    }
+    reordered->ordinals_by_id.resize(document_count);
+    iota(reordered->ordinals_by_id.begin(), reordered->ordinals_by_id.end(), 0);
+    sort(reordered->ordinals_by_id.begin(), reordered->ordinals_by_id.end(), [&reordered](uint32_t lhs, uint32_t rhs) {
+        return reordered->document_ids[lhs] < reordered->document_ids[rhs];
+    });
+
+    reordered->terms = segment.terms;
+    reordered->offsets = segment.offsets;
+    reordered->ordinals.reserve(segment.ordinals.size());
+    reordered->freqs.reserve(segment.freqs.size());
+    vector<pair<uint32_t, double>> postings;
+    for (uint32_t index = 0; index < segment.terms.size(); ++index) {
+        postings.clear();
+        for (uint32_t i = segment.offsets[index]; i < segment.offsets[index + 1]; ++i) {
+            postings.push_back({new_ordinals[segment.ordinals[i]], segment.freqs[i]});
+        }
+        sort(postings.begin(), postings.end());
+        for (const auto& [ordinal, term_freq] : postings) {
+            reordered->ordinals.push_back(ordinal);
+            reordered->freqs.push_back(term_freq);
+        }
+    }
+    return reordered;
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "forward_index.h"
+#include "intersection.h"
+#include "memory_usage.h"
+#include "term_dictionary.h"
+
+// Inverted index made of a small mutable buffer and immutable segments.
+//
+// New documents go to the buffer. Once it holds BUFFER_DOCUMENT_COUNT documents
+// it is frozen into a segment: the sorted ids of its documents and, for every
+// term, a run of ordinals (positions in the id array) with term frequencies,
+// all in flat arrays. Removing a document from a segment only sets its
+// tombstone bit.
+//
+// Compact additionally renumbers the documents of the resulting segment so that
+// documents sharing many terms get nearby ordinals. Ordinals are internal, the
+// id array translates them back to document ids.
+//
+// Adjacent segments of similar size, as well as segments that are mostly
+// tombstones, are merged on a background thread. The merge reads only immutable
+// segment data, and its result replaces the inputs during the next Add or
+// Remove. As before, reads must not run concurrently with Add and Remove.
+class PostingIndex {
+public:
+    static const size_t BUFFER_DOCUMENT_COUNT = 4096;
+
+    PostingIndex() = default;
+    // A merge in progress is not copied, the copy starts from the current segments
+    PostingIndex(const PostingIndex& other);
+    PostingIndex& operator=(const PostingIndex& other);
+    PostingIndex(PostingIndex&&) = default;
+    PostingIndex& operator=(PostingIndex&&) = default;
+
+    // `terms` must be sorted by term id, the document must not be in the index
+    void Add(int document_id, TermFrequencies terms);
+
+    // `terms` must be the ones the document was added with
+    void Remove(int document_id, TermFrequencies terms);
+
+    // Number of documents containing the term
+    size_t GetDocumentFreq(TermId term) const {
+        return term < document_freqs_.size() ? document_freqs_[term] : 0;
+    }
+
+    // Calls func(document_id, term_freq) for every document containing the term,
+    // stops as soon as func returns false
+    template <typename Func>
+    void ForEachPosting(TermId term, Func func) const;
+
+    // Calls on_match(document_id) for every document containing all the terms.
+    // Postings of the rarest term are walked and the others are searched by galloping,
+    // every step of the walk is charged to the budget (may be null).
+    // Reorders `terms` by document frequency.
+    template <typename Budget, typename Func>
+    void ForEachCommonDocument(std::pmr::vector<TermId>& terms, Budget* budget, Func on_match) const;
+
+    // Freezes the buffer and merges segments until the merge policy is satisfied
+    void Flush();
+
+    // Freezes the buffer, merges all segments into one without tombstones and
+    // orders its documents for locality
+    void Compact();
+
+    // Entries are stored postings, including those of removed documents not merged away yet
+    MemoryUsage GetMemoryUsage() const;
+
+    size_t GetSegmentCount() const {
+        return slots_.size();
+    }
+
+private:
+    struct Segment {
+        // Document id of every ordinal, sorted unless the segment was reordered
+        std::vector<int> document_ids;
+        // Ordinals in document id order, empty while document_ids is sorted
+        std::vector<uint32_t> ordinals_by_id;
+        // Sorted, postings of terms[i] are [offsets[i], offsets[i + 1])
+        std::vector<TermId> terms;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> ordinals;
+        std::vector<double> freqs;
+
+        // Range of postings of the term, empty if it is absent
+        std::pair<uint32_t, uint32_t> FindPostings(TermId term) const;
+
+        // NO_ORDINAL if the document is not in the segment
+        uint32_t FindOrdinal(int document_id) const;
+    };
+
+    static constexpr uint32_t NO_ORDINAL = std::numeric_limits<uint32_t>::max();
+
+    struct SegmentSlot {
+        std::shared_ptr<const Segment> segment;
+        std::vector<bool> deleted;
+        size_t live_count = 0;
+    };
+
+    struct PendingMerge {
+        std::vector<std::shared_ptr<const Segment>> inputs;
+        // Tombstones of the inputs when the merge started
+        std::vector<std::vector<bool>> deleted;
+        std::future<std::shared_ptr<const Segment>> result;
+    };
+
+    static std::shared_ptr<const Segment> MergeSegments(const std::vector<std::shared_ptr<const Segment>>& inputs,
+                                                        const std::vector<std::vector<bool>>& deleted);
+
+    void FreezeBuffer();
+
+    // Renumbers the documents so that those with many common terms are adjacent:
+    // every document is keyed by its terms ranked from the most frequent one,
+    // and the keys are sorted lexicographically
+    static std::shared_ptr<const Segment> ReorderForLocality(const Segment& segment);
+
+    // Installs a finished merge, then starts the next one if the policy asks for it.
+    // Waits for the running merge if `wait` is set.
+    void UpdateMerges(bool wait);
+
+    void InstallMerge();
+
+    // Replaces slots [first, last) with the merged segment, `deleted` are their tombstones when the merge started
+    void ReplaceSlots(std::vector<SegmentSlot>::iterator first, std::vector<SegmentSlot>::iterator last,
+                      std::shared_ptr<const Segment> merged, const std::vector<std::vector<bool>>& deleted);
+
+    void StartMerge();
+
+    template <typename Budget, typename Func>
+    void IntersectSegment(const SegmentSlot& slot, const std::pmr::vector<TermId>& terms, Budget* budget, Func& on_match) const;
+
+    template <typename Budget, typename Func>
+    void IntersectBuffer(const std::pmr::vector<TermId>& terms, Budget* budget, Func& on_match) const;
+
+    // Oldest segments first
+    std::vector<SegmentSlot> slots_;
+    // Postings of the buffered documents ordered by term, then by document
+    CountedMap<std::pair<TermId, int>, double> buffer_;
+    CountedSet<int> buffer_documents_;
+    // Indexed by TermId
+    std::vector<uint32_t> document_freqs_;
+    PendingMerge pending_;
+};
+
+template <typename Func>
+void PostingIndex::ForEachPosting(TermId term, Func func) const {
+    for (const SegmentSlot& slot : slots_) {
+        const Segment& segment = *slot.segment;
+        const auto [first, last] = segment.FindPostings(term);
+        for (uint32_t i = first; i < last; ++i) {
+            const uint32_t ordinal = segment.ordinals[i];
+            if (!slot.deleted[ordinal] && !func(segment.document_ids[ordinal], segment.freqs[i])) {
+                return;
+            }
+        }
+    }
+    for (auto it = buffer_.lower_bound({term, std::numeric_limits<int>::min()}); it != buffer_.end() && it->first.first == term; ++it) {
+        if (!func(it->first.second, it->second)) {
+            return;
+        }
+    }
+}
+
+template <typename Budget, typename Func>
+void PostingIndex::ForEachCommonDocument(std::pmr::vector<TermId>& terms, Budget* budget, Func on_match) const {
+    if (terms.empty()) {
+        return;
+    }
+    // The work is bounded by the rarest posting list, the others are only probed
+    std::sort(terms.begin(), terms.end(), [this](TermId lhs, TermId rhs) {
+        return GetDocumentFreq(lhs) < GetDocumentFreq(rhs);
+    });
+    // A document lives in one segment or in the buffer, so they are intersected separately
+    for (const SegmentSlot& slot : slots_) {
+        IntersectSegment(slot, terms, budget, on_match);
+        if (budget && budget->IsExhausted()) {
+            return;
+        }
+    }
+    IntersectBuffer(terms, budget, on_match);
+}
+
+template <typename Budget, typename Func>
+void PostingIndex::IntersectSegment(const SegmentSlot& slot, const std::pmr::vector<TermId>& terms, Budget* budget, Func& on_match) const {
+    const Segment& segment = *slot.segment;
+    std::pmr::vector<std::pair<const uint32_t*, const uint32_t*>> lists(terms.get_allocator().resource());
+    lists.reserve(terms.size());
+    for (const TermId term : terms) {
+        const auto [first, last] = segment.FindPostings(term);
+        if (first == last) {
+            return;
+        }
+        lists.push_back({segment.ordinals.data() + first, segment.ordinals.data() + last});
+    }
+
+    auto& [it, rarest_end] = lists.front();
+    while (it != rarest_end) {
+        if (budget && !budget->Consume()) {
+            return;
+        }
+        const uint32_t ordinal = *it;
+        uint32_t next_ordinal = ordinal;
+        for (size_t i = 1; i < lists.size() && next_ordinal == ordinal; ++i) {
+            auto& [first, last] = lists[i];
+            first = GallopLowerBound(first, last, ordinal);
+            if (first == last) {
+                return;
+            }
+            next_ordinal = *first;
+        }
+        if (next_ordinal == ordinal) {
+            if (!slot.deleted[ordinal]) {
+                on_match(segment.document_ids[ordinal]);
+            }
+            ++it;
+        } else {
+            // Skips every posting of the rarest list that some other list does not have
+            it = GallopLowerBound(it, rarest_end, next_ordinal);
+        }
+    }
+}
+
+template <typename Budget, typename Func>
+void PostingIndex::IntersectBuffer(const std::pmr::vector<TermId>& terms, Budget* budget, Func& on_match) const {
+    // Only terms with buffered postings can match
+    for (const TermId term : terms) {
+        const auto it = buffer_.lower_bound({term, std::numeric_limits<int>::min()});
+        if (it == buffer_.end() || it->first.first != term) {
+            return;
+        }
+    }
+
+    const TermId rarest = terms.front();
+    auto it = buffer_.lower_bound({rarest, std::numeric_limits<int>::min()});
+    while (it != buffer_.end() && it->first.first == rarest) {
+        if (budget && !budget->Consume()) {
+            return;
+        }
+        const int document_id = it->first.second;
+        int next_document_id = document_id;
+        for (size_t i = 1; i < terms.size() && next_document_id == document_id; ++i) {
+            const auto found = buffer_.lower_bound({terms[i], document_id});
+            if (found == buffer_.end() || found->first.first != terms[i]) {
+                return;
+            }
+            next_document_id = found->first.second;
+        }
+        if (next_document_id == document_id) {
+            on_match(document_id);
+            ++it;
+        } else {
+            it = buffer_.lower_bound({rarest, next_document_id});
+        }
+    }
+}
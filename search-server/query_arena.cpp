@@ -0,0 +1,78 @@
+#include "query_arena.h"
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t INITIAL_BUFFER_SIZE = 16 * 1024;
+const size_t MAX_BUFFER_SIZE = 64 * 1024 * 1024;
+
+// Counts what the arena had to request beyond its buffer
+class OverflowResource : public pmr::memory_resource {
+public:
+    size_t GetAllocated() const {
+        return allocated_;
+    }
+
+    void Reset() {
+        allocated_ = 0;
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        allocated_ += bytes;
+        return pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    size_t allocated_ = 0;
+};
+
+struct ThreadArena {
+    vector<byte> buffer = vector<byte>(INITIAL_BUFFER_SIZE);
+    OverflowResource overflow;
+    optional<pmr::monotonic_buffer_resource> resource;
+    int depth = 0;
+};
+
+ThreadArena& GetThreadArena() {
+    static thread_local ThreadArena arena;
+    return arena;
+}
+
+}  // namespace
+
+QueryArena::QueryArena() {
+    ThreadArena& arena = GetThreadArena();
+    if (arena.depth++ == 0) {
+        arena.resource.emplace(arena.buffer.data(), arena.buffer.size(), &arena.overflow);
+    }
+}
+
+QueryArena::~QueryArena() {
+    ThreadArena& arena = GetThreadArena();
+    if (--arena.depth > 0) {
+        return;
+    }
+    arena.resource.reset();
+    if (arena.overflow.GetAllocated() > 0 && arena.buffer.size() < MAX_BUFFER_SIZE) {
+        const size_t size = min(MAX_BUFFER_SIZE, arena.buffer.size() + arena.overflow.GetAllocated());
+        arena.buffer = vector<byte>(size);
+    }
+    arena.overflow.Reset();
+}
+
+pmr::memory_resource* QueryArena::GetResource() const {
+    return &*GetThreadArena().resource;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <memory_resource>
+
+// Memory for the temporaries of one query. Allocations are carved out of a
+// thread-local buffer and released all at once when the outermost arena of the
+// thread is destroyed; nested arenas share the memory of the outer one.
+// The buffer grows to the largest amount a query on this thread has needed,
+// so in a steady state queries do not call the global allocator at all.
+// The resource must only be used by the thread that created the arena.
+class QueryArena {
+public:
+    QueryArena();
+    ~QueryArena();
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    std::pmr::memory_resource* GetResource() const;
+};
@@ -0,0 +1,98 @@
+#include "query_executor.h"
+
+using namespace std;
+
+QueryExecutor::QueryExecutor(const SearchServer& search_server, size_t thread_count, size_t lane_capacity)
+    : server_(search_server)
+    , lane_capacity_(lane_capacity) {
+    if (thread_count == 0) {
+        throw invalid_argument("Executor needs at least one thread");
+    }
+    try {
+        workers_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_.emplace_back([this] { Work(); });
+        }
+    } catch (...) {
+        // The destructor does not run, joinable threads left in workers_ would terminate the program
+        Stop();
+        throw;
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    Stop();
+}
+
+future<vector<Document>> QueryExecutor::FindTopDocumentsAsync(string raw_query, DocumentStatus status, QueryPriority priority) {
+    return FindTopDocumentsAsync(move(raw_query), [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, priority);
+}
+
+future<vector<Document>> QueryExecutor::FindTopDocumentsAsync(string raw_query, QueryPriority priority) {
+    return FindTopDocumentsAsync(move(raw_query), DocumentStatus::ACTUAL, priority);
+}
+
+QueryExecutorStats QueryExecutor::GetStats() const {
+    lock_guard guard(mutex_);
+    QueryExecutorStats stats;
+    stats.interactive = lanes_[static_cast<size_t>(QueryPriority::INTERACTIVE)].stats;
+    stats.batch = lanes_[static_cast<size_t>(QueryPriority::BATCH)].stats;
+    return stats;
+}
+
+future<vector<Document>> QueryExecutor::Submit(Task task, QueryPriority priority) {
+    future<vector<Document>> result = task.get_future();
+    {
+        lock_guard guard(mutex_);
+        Lane& lane = lanes_[static_cast<size_t>(priority)];
+        if (lane.tasks.size() >= lane_capacity_) {
+            ++lane.stats.rejected;
+            throw QueryRejectedError("Query queue is full");
+        }
+        lane.tasks.push_back(move(task));
+        ++lane.stats.submitted;
+        lane.stats.queued = lane.tasks.size();
+    }
+    has_tasks_.notify_one();
+    return result;
+}
+
+void QueryExecutor::Stop() {
+    {
+        lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void QueryExecutor::Work() {
+    Lane& interactive = lanes_[static_cast<size_t>(QueryPriority::INTERACTIVE)];
+    Lane& batch = lanes_[static_cast<size_t>(QueryPriority::BATCH)];
+    while (true) {
+        Task task;
+        Lane* lane = nullptr;
+        {
+            unique_lock lock(mutex_);
+            has_tasks_.wait(lock, [&] {
+                return stopping_ || !interactive.tasks.empty() || !batch.tasks.empty();
+            });
+            if (interactive.tasks.empty() && batch.tasks.empty()) {
+                return;
+            }
+            const bool batch_turn = ++dequeued_ % BATCH_TURN == 0;
+            lane = interactive.tasks.empty() || (batch_turn && !batch.tasks.empty()) ? &batch : &interactive;
+            task = move(lane->tasks.front());
+            lane->tasks.pop_front();
+            lane->stats.queued = lane->tasks.size();
+        }
+        // Exceptions of the query are stored in its future
+        task();
+        lock_guard guard(mutex_);
+        ++lane->stats.completed;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "search_server.h"
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class QueryPriority {
+    INTERACTIVE,
+    BATCH,
+};
+
+// Thrown by QueryExecutor when the lane of the query is full
+class QueryRejectedError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct QueryExecutorStats {
+    struct Lane {
+        size_t submitted = 0;
+        size_t rejected = 0;
+        size_t completed = 0;
+        size_t queued = 0;
+    };
+    Lane interactive;
+    Lane batch;
+};
+
+// Runs queries on its own worker threads. Every priority has a bounded lane,
+// a query submitted into a full lane is rejected at once rather than blocking
+// the caller. Interactive queries are served first, batch queries get every
+// BATCH_TURN-th free worker so they still make progress under load.
+// The server must not be modified while the executor is running.
+class QueryExecutor {
+public:
+    QueryExecutor(const SearchServer& search_server, size_t thread_count, size_t lane_capacity);
+    // Finishes the queued queries and stops the workers
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    template <typename DocumentPredicate>
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, DocumentPredicate document_predicate,
+                                                             QueryPriority priority = QueryPriority::INTERACTIVE);
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, DocumentStatus status,
+                                                             QueryPriority priority = QueryPriority::INTERACTIVE);
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query,
+                                                             QueryPriority priority = QueryPriority::INTERACTIVE);
+
+    QueryExecutorStats GetStats() const;
+
+private:
+    using Task = std::packaged_task<std::vector<Document>()>;
+
+    static const size_t BATCH_TURN = 8;
+
+    struct Lane {
+        std::deque<Task> tasks;
+        QueryExecutorStats::Lane stats;
+    };
+
+    std::future<std::vector<Document>> Submit(Task task, QueryPriority priority);
+    void Work();
+    // Lets the workers finish the queued tasks and joins them
+    void Stop();
+
+    const SearchServer& server_;
+    const size_t lane_capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    std::array<Lane, 2> lanes_;
+    size_t dequeued_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+template <typename DocumentPredicate>
+std::future<std::vector<Document>> QueryExecutor::FindTopDocumentsAsync(std::string raw_query, DocumentPredicate document_predicate,
+                                                                        QueryPriority priority) {
+    return Submit(Task([this, raw_query = std::move(raw_query), document_predicate] {
+        return server_.FindTopDocuments(raw_query, document_predicate);
+    }), priority);
+}
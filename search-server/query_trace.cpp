@@ -0,0 +1,36 @@
+#include "query_trace.h"
+
+using namespace std;
+
+namespace {
+
+string_view GetRoleName(QueryTrace::TermRole role) {
+    switch (role) {
+        case QueryTrace::TermRole::PLUS: return "plus"sv;
+        case QueryTrace::TermRole::REQUIRED: return "required"sv;
+        case QueryTrace::TermRole::MINUS: return "minus"sv;
+        default: return "unknown"sv;
+    }
+}
+
+}  // namespace
+
+ostream& operator<<(ostream& out, const QueryTrace& trace) {
+    out << "mode: "sv << (trace.is_conjunctive ? "and"sv : "or"sv) << '\n';
+    for (const QueryTrace::Term& term : trace.terms) {
+        out << "term \""sv << term.word << "\" "sv << GetRoleName(term.role)
+            << ": postings "sv << term.posting_length
+            << ", visited "sv << term.postings_visited
+            << ", filtered "sv << term.postings_filtered << '\n';
+    }
+    out << "postings: visited "sv << trace.postings_visited
+        << ", skipped "sv << trace.postings_skipped
+        << ", filtered "sv << trace.postings_filtered << '\n';
+    out << "documents: accumulated "sv << trace.accumulator_size
+        << ", removed by minus words "sv << trace.documents_removed_by_minus << '\n';
+    out << "time: parse "sv << trace.parse_time.count()
+        << " ns, traversal "sv << trace.traversal_time.count()
+        << " ns, scoring "sv << trace.scoring_time.count()
+        << " ns, top-k "sv << trace.top_k_time.count() << " ns\n"sv;
+    return out;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+// Work done by one query, filled in by SearchServer::ProfileFindTopDocuments
+struct QueryTrace {
+    enum class TermRole {
+        PLUS,
+        REQUIRED,
+        MINUS,
+    };
+
+    struct Term {
+        // Valid while the server is alive
+        std::string_view word;
+        TermRole role = TermRole::PLUS;
+        // Number of documents containing the word
+        size_t posting_length = 0;
+        // Postings read by the OR traversal, zero for required words
+        size_t postings_visited = 0;
+        // Postings of documents rejected by the predicate
+        size_t postings_filtered = 0;
+    };
+
+    std::vector<Term> terms;
+    // Every required word must be present, postings are intersected instead of traversed
+    bool is_conjunctive = false;
+
+    // Postings read by the traversal or by the walk of the intersection
+    size_t postings_visited = 0;
+    // Postings of required words the intersection jumped over
+    size_t postings_skipped = 0;
+    size_t postings_filtered = 0;
+    size_t documents_removed_by_minus = 0;
+    // Documents that got a relevance before the minus words were applied
+    size_t accumulator_size = 0;
+
+    std::chrono::nanoseconds parse_time{0};
+    std::chrono::nanoseconds traversal_time{0};
+    std::chrono::nanoseconds scoring_time{0};
+    std::chrono::nanoseconds top_k_time{0};
+};
+
+// Human-readable EXPLAIN output, one line per term
+std::ostream& operator<<(std::ostream& out, const QueryTrace& trace);
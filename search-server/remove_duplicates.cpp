@@ -4,17 +4,17 @@ using namespace std;
 
 void RemoveDuplicates(SearchServer& search_server) {
     set<int> duplicat;
-    set<set<string_view>> documents_words_freq_;
+    // Term ids of a document come sorted and unique, so equal word sets give equal vectors
+    set<vector<TermId>> documents_terms;
     for (const int document_id : search_server) {
-        const auto& words_freq = search_server.GetWordFrequencies(document_id);
-        set<string_view> words;
-        for (const auto& [word, freq] : words_freq) {
-            words.insert(word);
+        vector<TermId> terms;
+        for (const auto& [term, freq] : search_server.GetTermFrequencies(document_id)) {
+            terms.push_back(term);
         }
-        if (documents_words_freq_.count(words)) {
+        if (documents_terms.count(terms)) {
             duplicat.insert(document_id);
         } else {
-            documents_words_freq_.insert(words);
+            documents_terms.insert(move(terms));
         }
     }
 
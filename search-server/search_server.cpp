@@ -1,4 +1,5 @@
 #include "search_server.h"
+#include "intersection.h"
 #include "paginator.h"
 #include "string_processing.h"
 #include <algorithm>
@@ -17,22 +18,80 @@ SearchServer::SearchServer(const string& stop_words_text) : SearchServer(SplitIn
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
                      const vector<int>& ratings) {
+    METRICS_SCOPE(MetricStage::ADD);
+    CheckNewDocumentId(document_id);
+    if(!IsValidWord(document)) {
+        throw invalid_argument("This string contains forbidden characters");
+    }
+    IndexDocument(document_id, SplitIntoWordsNoStop(document), status, ratings);
+}
+
+void SearchServer::AddDocuments(const vector<DocumentRecord>& documents) {
+    AddDocumentsImpl(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const execution::sequenced_policy&, const vector<DocumentRecord>& documents) {
+    AddDocumentsImpl(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const execution::parallel_policy&, const vector<DocumentRecord>& documents) {
+    AddDocumentsImpl(execution::par, documents);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentsImpl(ExecutionPolicy policy, const vector<DocumentRecord>& documents) {
+    set<int> batch_ids;
+    for (const DocumentRecord& document : documents) {
+        CheckNewDocumentId(document.id);
+        if (!batch_ids.insert(document.id).second) {
+            throw invalid_argument("This id is already occupied");
+        }
+    }
+    // An exception escaping a parallel algorithm terminates the program, so nothing throws inside them
+    if (!all_of(policy, documents.begin(), documents.end(), [](const DocumentRecord& document) {
+            return IsValidWord(document.text);
+        })) {
+        throw invalid_argument("This string contains forbidden characters");
+    }
+    vector<vector<string_view>> documents_words(documents.size());
+    transform(policy, documents.begin(), documents.end(), documents_words.begin(), [this](const DocumentRecord& document) {
+        return SplitIntoWordsNoStop(document.text);
+    });
+    // The index itself is not thread-safe, documents are inserted one by one
+    for (size_t i = 0; i < documents.size(); ++i) {
+        METRICS_SCOPE(MetricStage::ADD);
+        IndexDocument(documents[i].id, documents_words[i], documents[i].status, documents[i].ratings);
+    }
+}
+
+void SearchServer::CheckNewDocumentId(int document_id) const {
     if(document_id < 0) {
         throw invalid_argument("id < 0");
     }
     if(documents_.count(document_id)) {
         throw invalid_argument("This id is already occupied");
     }
-    if(!IsValidWord(document)) {
-        throw invalid_argument("This string contains forbidden characters");
-    }
+}
+
+void SearchServer::IndexDocument(int document_id, const vector<string_view>& words, DocumentStatus status,
+                                 const vector<int>& ratings) {
     document_id_.insert(document_id);
-    const vector<string_view> words = SplitIntoWordsNoStop(document);
     const double inv_word_count = 1.0 / words.size();
+    vector<TermId> document_terms;
+    document_terms.reserve(words.size());
     for (string_view word : words) {
-        word_to_document_freqs_[string(word)][document_id] += inv_word_count;
-        document_words_freqs_[document_id][word] += inv_word_count;
+        document_terms.push_back(terms_.Add(word));
     }
+    sort(document_terms.begin(), document_terms.end());
+
+    vector<TermFrequency> term_freqs;
+    for (auto it = document_terms.begin(); it != document_terms.end();) {
+        const auto run_end = upper_bound(it, document_terms.end(), *it);
+        term_freqs.push_back({*it, (run_end - it) * inv_word_count});
+        it = run_end;
+    }
+    document_terms_freqs_.Add(document_id, term_freqs);
+    postings_.Add(document_id, document_terms_freqs_.Get(document_id));
     documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
 }
 
@@ -47,104 +106,190 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+vector<Document> SearchServer::FindTopDocumentsPage(string_view raw_query, DocumentStatus status, size_t offset, size_t limit) const {
+    auto predicate = [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        };
+    return FindTopDocumentsPage(raw_query, predicate, offset, limit);
+}
+
+vector<Document> SearchServer::FindTopDocumentsPage(string_view raw_query, size_t offset, size_t limit) const {
+    return FindTopDocumentsPage(raw_query, DocumentStatus::ACTUAL, offset, limit);
+}
+
+SearchResult SearchServer::FindTopDocumentsWithin(string_view raw_query, const QueryBudget& budget, DocumentStatus status) const {
+    auto predicate = [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        };
+    return FindTopDocumentsWithin(raw_query, budget, predicate);
+}
+
+SearchResult SearchServer::FindTopDocumentsWithin(string_view raw_query, const QueryBudget& budget) const {
+    return FindTopDocumentsWithin(raw_query, budget, DocumentStatus::ACTUAL);
+}
+
+ProfiledSearchResult SearchServer::ProfileFindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    auto predicate = [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        };
+    return ProfileFindTopDocuments(raw_query, predicate);
+}
+
+ProfiledSearchResult SearchServer::ProfileFindTopDocuments(string_view raw_query) const {
+    return ProfileFindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
+bool SearchServer::HasDocument(int document_id) const {
+    return documents_.count(document_id) > 0;
+}
+
+MemoryStats SearchServer::GetMemoryStats() const {
+    MemoryStats stats;
+    stats.inverted_index = postings_.GetMemoryUsage();
+    stats.forward_index = document_terms_freqs_.GetMemoryUsage();
+    stats.term_dictionary = terms_.GetMemoryUsage();
+    stats.documents = GetNodeMemoryUsage(documents_);
+    stats.document_ids = GetNodeMemoryUsage(document_id_);
+    stats.stop_words = GetNodeMemoryUsage(stop_words_);
+    for (const string& word : stop_words_) {
+        stats.stop_words.bytes += GetHeapBytes(word);
+    }
+    return stats;
+}
+
+void SearchServer::Compact() {
+    postings_.Compact();
+    document_terms_freqs_.Compact();
+    terms_.Compact();
+}
+
+void SearchServer::SetMaxPrefixExpansion(size_t max_expansion) {
+    max_prefix_expansion_ = max_expansion;
+}
+
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
-    const Query query = ParseQuery(raw_query);
+    METRICS_SCOPE(MetricStage::MATCH);
+    QueryArena arena;
+    const Query query = ParseQuery(raw_query, arena.GetResource());
     vector<string_view> matched_words;
-    for (string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(string(word)) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(string(word)).count(document_id)) {
-            return {matched_words, documents_.at(document_id).status};
-        }
-    }
-    for (string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(string(word)) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(string(word)).count(document_id)) {
-            matched_words.push_back(word);
-        }
-    }
-    return {matched_words, documents_.at(document_id).status};
+    const DocumentStatus status = MatchParsedQuery(query, document_id, matched_words);
+    return {matched_words, status};
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy&, string_view raw_query, int document_id) const {
     return MatchDocument(raw_query, document_id);
 }
 
+// A single document has too few terms for a parallel intersection to pay off
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy&, string_view raw_query, int document_id) const {
-    Query query = ParseQueryPar(raw_query);
-
-    const auto& documents = document_words_freqs_.at(document_id);
+    return MatchDocument(raw_query, document_id);
+}
 
-    if(any_of(execution::par, query.minus_words.begin(), query.minus_words.end(), [&documents](auto word){
-        return documents.count(word);
-    })) {
-        return {{}, documents_.at(document_id).status};
+MatchedDocuments SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const {
+    METRICS_SCOPE(MetricStage::MATCH);
+    QueryArena arena;
+    const Query query = ParseQuery(raw_query, arena.GetResource());
+    MatchedDocuments result;
+    result.offsets.reserve(document_ids.size() + 1);
+    result.statuses.reserve(document_ids.size());
+    result.offsets.push_back(0);
+    for (const int document_id : document_ids) {
+        result.statuses.push_back(MatchParsedQuery(query, document_id, result.words));
+        result.offsets.push_back(result.words.size());
     }
+    return result;
+}
 
-    vector<string_view> matched_words(query.plus_words.size());
-
-    vector<string_view>::iterator it = copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&documents](auto word){
-        return documents.count(word);
-    });
-
-    sort(execution::par, matched_words.begin(), it);
-    matched_words.erase(unique(execution::par, matched_words.begin(), it), matched_words.end());
+DocumentStatus SearchServer::MatchParsedQuery(const Query& query, int document_id, vector<string_view>& matched_words) const {
+    const DocumentStatus status = documents_.at(document_id).status;
+    const TermFrequencies document_terms = document_terms_freqs_.Get(document_id);
+    if (HasAnyTerm(document_id, query.minus_terms) || query.has_missing_required_word
+        || !HasAllTerms(document_id, query.required_terms)) {
+        return status;
+    }
 
-    return {matched_words, documents_.at(document_id).status};
+    const size_t first_matched = matched_words.size();
+    IntersectSorted(query.plus_terms.begin(), query.plus_terms.end(), document_terms.begin(), document_terms.end(),
+                    [this, &matched_words](auto term, auto) { matched_words.push_back(terms_.GetWord(*term)); },
+                    IdentityKey{}, [](const TermFrequency& record) { return record.term; });
+    sort(matched_words.begin() + first_matched, matched_words.end());
+    return status;
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const map<string_view, double> empty;
-    if (!document_words_freqs_.count(document_id)) {
-        return empty;
+void SearchServer::StartTrace(const Query& query, QueryTrace& trace) const {
+    trace.is_conjunctive = query.IsConjunctive();
+    trace.terms.reserve(query.plus_terms.size() + query.minus_terms.size());
+    for (const TermId term : query.plus_terms) {
+        QueryTrace::Term term_trace;
+        term_trace.word = terms_.GetWord(term);
+        term_trace.role = binary_search(query.required_terms.begin(), query.required_terms.end(), term)
+            ? QueryTrace::TermRole::REQUIRED : QueryTrace::TermRole::PLUS;
+        term_trace.posting_length = postings_.GetDocumentFreq(term);
+        trace.terms.push_back(term_trace);
+    }
+    for (const TermId term : query.minus_terms) {
+        QueryTrace::Term term_trace;
+        term_trace.word = terms_.GetWord(term);
+        term_trace.role = QueryTrace::TermRole::MINUS;
+        term_trace.posting_length = postings_.GetDocumentFreq(term);
+        trace.terms.push_back(term_trace);
     }
-    return document_words_freqs_.at(document_id);
 }
 
-void SearchServer::RemoveDocument(int document_id) {
-    const auto it = find(begin(), end(), document_id);
-    if (it != end()) {
-        document_id_.erase(document_id);
-        documents_.erase(document_id);
-
-        vector<string_view> document_words_freqs_delete_;
-
-        transform(document_words_freqs_[document_id].begin(), document_words_freqs_[document_id].end(), back_inserter(document_words_freqs_delete_), [](const auto& words){
-            const auto& [key, value] = words;
-            return key;});
+bool SearchServer::HasAnyTerm(int document_id, const pmr::vector<TermId>& terms) const {
+    const TermFilter filter = document_terms_freqs_.GetTermFilter(document_id);
+    if (none_of(terms.begin(), terms.end(), [&filter](TermId term) { return filter.MayContain(term); })) {
+        return false;
+    }
+    const TermFrequencies document_terms = document_terms_freqs_.Get(document_id);
+    bool found = false;
+    IntersectSorted(terms.begin(), terms.end(), document_terms.begin(), document_terms.end(),
+                    [&found](auto, auto) { found = true; }, IdentityKey{}, [](const TermFrequency& record) { return record.term; });
+    return found;
+}
 
-        for_each(execution::seq, document_words_freqs_delete_.begin(), document_words_freqs_delete_.end(), [this, document_id](string_view key){
-            word_to_document_freqs_[string(key)].erase(document_id);});
-        document_words_freqs_.erase(document_id);
+bool SearchServer::HasAllTerms(int document_id, const pmr::vector<TermId>& terms) const {
+    const TermFilter filter = document_terms_freqs_.GetTermFilter(document_id);
+    if (!all_of(terms.begin(), terms.end(), [&filter](TermId term) { return filter.MayContain(term); })) {
+        return false;
     }
+    const TermFrequencies document_terms = document_terms_freqs_.Get(document_id);
+    size_t found = 0;
+    IntersectSorted(terms.begin(), terms.end(), document_terms.begin(), document_terms.end(),
+                    [&found](auto, auto) { ++found; }, IdentityKey{}, [](const TermFrequency& record) { return record.term; });
+    return found == terms.size();
 }
 
-void SearchServer::RemoveDocument(const execution::sequenced_policy&, int document_id) {
-    RemoveDocument(document_id);
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    return {document_terms_freqs_.Get(document_id), terms_};
 }
-void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
-    const auto it = find(begin(), end(), document_id);
-    if (it != end()) {
-        document_id_.erase(document_id);
-        documents_.erase(document_id);
 
-        vector<string_view> document_words_freqs_delete_;
+TermFrequencies SearchServer::GetTermFrequencies(int document_id) const {
+    return document_terms_freqs_.Get(document_id);
+}
 
-        transform(document_words_freqs_[document_id].begin(), document_words_freqs_[document_id].end(), back_inserter(document_words_freqs_delete_), [](const auto& words){
-            const auto& [key, value] = words;
-            return key;});
+void SearchServer::RemoveDocument(int document_id) {
+    RemoveDocument(execution::seq, document_id);
+}
 
-        for_each(execution::par, document_words_freqs_delete_.begin(), document_words_freqs_delete_.end(), [this, document_id](string_view key){
-            word_to_document_freqs_[string(key)].erase(document_id);});
-        document_words_freqs_.erase(document_id);
+void SearchServer::RemoveDocument(const execution::sequenced_policy&, int document_id) {
+    METRICS_SCOPE(MetricStage::REMOVE);
+    if (documents_.count(document_id) == 0) {
+        return;
     }
+    postings_.Remove(document_id, document_terms_freqs_.Get(document_id));
+    document_id_.erase(document_id);
+    documents_.erase(document_id);
+    document_terms_freqs_.Remove(document_id);
+}
+
+// Removal only updates the small buffer or sets a tombstone, there is nothing to parallelize
+void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
+    RemoveDocument(execution::seq, document_id);
 }
 
 bool SearchServer::IsValidWord(string_view word) {
@@ -177,6 +322,14 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
 }
 
 SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
+    const bool is_required = text[0] == '+';
+    if (is_required) {
+        text = text.substr(1);
+        // Word shouldn't be empty or be both required and excluded
+        if (text.empty() || text[0] == '-' || text[0] == '+') {
+            throw invalid_argument("Required words error");
+        }
+    }
     bool is_minus = false;
     bool first_minus = text[0] == '-';
     bool only_minus = first_minus && text.size() == 1;
@@ -189,54 +342,59 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         is_minus = true;
         text = text.substr(1);
     }
-    SearchServer::QueryWord result = {text, is_minus, IsStopWord(text)};
+    bool is_prefix = text.back() == '*';
+    if (is_prefix) {
+        text.remove_suffix(1);
+        if (text.empty()) {
+            throw invalid_argument("Prefix words error");
+        }
+        if (is_required) {
+            throw invalid_argument("Prefix words can not be required");
+        }
+    }
+    SearchServer::QueryWord result = {text, is_minus, !is_prefix && IsStopWord(text), is_prefix, is_required};
     return result;
 }
 
-SearchServer::Query SearchServer::ParseQuery(string_view text) const {
+SearchServer::Query SearchServer::ParseQuery(string_view text, pmr::memory_resource* resource) const {
+    METRICS_SCOPE(MetricStage::PARSE);
     if(!IsValidWord(text)) {
         throw invalid_argument("This string contains forbidden characters");
     }
-    Query query;
-    for (string_view word : SplitIntoWords(text)) {
+    Query query(resource);
+    for (string_view word : SplitIntoWords(text, resource)) {
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
-            } else {
-                query.plus_words.push_back(query_word.data);
+        if (query_word.is_stop) {
+            continue;
+        }
+        pmr::vector<TermId>& terms = query_word.is_minus ? query.minus_terms : query.plus_terms;
+        if (query_word.is_prefix) {
+            // Words of removed documents stay in the dictionary, they must not take up the expansion
+            terms_.FindPrefix(query_word.data, max_prefix_expansion_, [this](TermId term) {
+                return postings_.GetDocumentFreq(term) > 0;
+            }, back_inserter(terms));
+        } else if (const optional<TermId> term = terms_.Find(query_word.data)) {
+            terms.push_back(*term);
+            if (query_word.is_required) {
+                query.required_terms.push_back(*term);
             }
+        } else if (query_word.is_required) {
+            query.has_missing_required_word = true;
         }
     }
 
-    sort(query.minus_words.begin(), query.minus_words.end());
-    sort(query.plus_words.begin(), query.plus_words.end());
+    sort(query.minus_terms.begin(), query.minus_terms.end());
+    sort(query.plus_terms.begin(), query.plus_terms.end());
 
-    query.minus_words.erase(unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
-    query.plus_words.erase(unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
+    query.minus_terms.erase(unique(query.minus_terms.begin(), query.minus_terms.end()), query.minus_terms.end());
+    query.plus_terms.erase(unique(query.plus_terms.begin(), query.plus_terms.end()), query.plus_terms.end());
+    sort(query.required_terms.begin(), query.required_terms.end());
+    query.required_terms.erase(unique(query.required_terms.begin(), query.required_terms.end()), query.required_terms.end());
 
     return query;
 }
 
-SearchServer::Query SearchServer::ParseQueryPar(string_view text) const {
-    if(!IsValidWord(text)) {
-        throw invalid_argument("This string contains forbidden characters");
-    }
-    Query query;
-    for (string_view word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
-            } else {
-                query.plus_words.push_back(query_word.data);
-            }
-        }
-    }
-    return query;
-}
-
 // Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(string(word)).size());
+double SearchServer::ComputeTermInverseDocumentFreq(TermId term) const {
+    return log(GetDocumentCount() * 1.0 / postings_.GetDocumentFreq(term));
 }
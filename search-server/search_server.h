@@ -3,24 +3,89 @@
 #include <exception>
 #include <functional>
 #include <future>
+#include <memory_resource>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
 #include <algorithm>
 #include <stdexcept>
+#include <chrono>
 #include <cmath>
 #include <execution>
+#include <limits>
 #include <string_view>
 
 #include "document.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "forward_index.h"
+#include "intersection.h"
+#include "memory_usage.h"
+#include "metrics.h"
+#include "posting_index.h"
+#include "query_arena.h"
+#include "query_trace.h"
+#include "term_dictionary.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+// Default limit of the number of index words a `prefix*` query word expands to
+const size_t MAX_PREFIX_EXPANSION = 64;
+
 const double EPSILON = 1e-6;
 
+// Result of SearchServer::MatchDocuments, all matched words are kept in one buffer:
+// words of the i-th requested document are words[offsets[i]] .. words[offsets[i + 1]]
+struct MatchedDocuments {
+    std::vector<std::string_view> words;
+    std::vector<size_t> offsets;
+    std::vector<DocumentStatus> statuses;
+};
+
+// Document for bulk ingestion, the text is only read while it is being added
+struct DocumentRecord {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Limits the work of a single query: whichever runs out first stops the posting traversal
+struct QueryBudget {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    size_t max_postings = std::numeric_limits<size_t>::max();
+};
+
+struct SearchResult {
+    std::vector<Document> documents;
+    // The budget ran out, documents are the best of those found so far
+    bool is_partial = false;
+};
+
+struct ProfiledSearchResult {
+    std::vector<Document> documents;
+    QueryTrace trace;
+};
+
+// Bytes and entries of the structures of a SearchServer
+struct MemoryStats {
+    // Entries are postings, including those of removed documents not merged away yet
+    MemoryUsage inverted_index;
+    // Entries are (term, frequency) records of the documents
+    MemoryUsage forward_index;
+    // Entries are words
+    MemoryUsage term_dictionary;
+    MemoryUsage documents;
+    MemoryUsage document_ids;
+    MemoryUsage stop_words;
+
+    size_t GetTotalBytes() const {
+        return inverted_index.bytes + forward_index.bytes + term_dictionary.bytes + documents.bytes
+            + document_ids.bytes + stop_words.bytes;
+    }
+};
+
 class SearchServer {
 public:
     template <typename StringContainer>
@@ -31,6 +96,12 @@ public:
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const std::vector<int>& ratings);
 
+    // Adds all documents or none of them: the whole batch is validated first.
+    // The parallel version splits the texts into words concurrently.
+    void AddDocuments(const std::vector<DocumentRecord>& documents);
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<DocumentRecord>& documents);
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<DocumentRecord>& documents);
+
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
 
@@ -47,13 +118,69 @@ public:
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query) const;
 
+    // Returns documents [offset, offset + limit) of the full ranking. Only the
+    // top (offset + limit) documents are ordered, the rest of the matches are not.
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsPage(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                               size_t offset, size_t limit) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsPage(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+                                               size_t offset, size_t limit) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsPage(ExecutionPolicy policy, std::string_view raw_query, size_t offset, size_t limit) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, size_t offset, size_t limit) const;
+
+    std::vector<Document> FindTopDocumentsPage(std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit) const;
+
+    std::vector<Document> FindTopDocumentsPage(std::string_view raw_query, size_t offset, size_t limit) const;
+
+    // Stops once the budget is exhausted and returns the best documents found so far.
+    // Rare words are visited first, as they contribute the most to relevance.
+    template <typename DocumentPredicate>
+    SearchResult FindTopDocumentsWithin(std::string_view raw_query, const QueryBudget& budget, DocumentPredicate document_predicate) const;
+
+    SearchResult FindTopDocumentsWithin(std::string_view raw_query, const QueryBudget& budget, DocumentStatus status) const;
+
+    SearchResult FindTopDocumentsWithin(std::string_view raw_query, const QueryBudget& budget) const;
+
+    // Same results as the sequential FindTopDocuments together with a trace of the work done.
+    // Other searches pass no trace and skip all of its bookkeeping.
+    template <typename DocumentPredicate>
+    ProfiledSearchResult ProfileFindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    ProfiledSearchResult ProfileFindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    ProfiledSearchResult ProfileFindTopDocuments(std::string_view raw_query) const;
+
     int GetDocumentCount() const;
 
+    bool HasDocument(int document_id) const;
+
+    MemoryStats GetMemoryStats() const;
+
+    // Merges the index into a single segment without removed documents, squeezes
+    // removed documents out of the forward index and releases slack capacity.
+    // Takes time proportional to the index size.
+    void Compact();
+
+    // A query word ending with '*' matches up to `max_expansion` index words with that prefix
+    // (the lexicographically smallest ones still present in some document)
+    void SetMaxPrefixExpansion(size_t max_expansion);
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Parses the query once and matches it against every given document
+    MatchedDocuments MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    // Views are invalidated by adding or removing documents
+    WordFrequencies GetWordFrequencies(int document_id) const;
+    TermFrequencies GetTermFrequencies(int document_id) const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
@@ -72,11 +199,13 @@ private:
         int rating;
         DocumentStatus status;
     };
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_words_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_id_;
+    const CountedSet<std::string, std::less<>> stop_words_;
+    TermDictionary terms_;
+    PostingIndex postings_;
+    ForwardIndex document_terms_freqs_;
+    size_t max_prefix_expansion_ = MAX_PREFIX_EXPANSION;
+    CountedMap<int, DocumentData> documents_;
+    CountedSet<int> document_id_;
     static bool IsValidWord(std::string_view word);
 
     bool IsStopWord(std::string_view word) const;
@@ -85,33 +214,137 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    void CheckNewDocumentId(int document_id) const;
+
+    // `words` must not contain stop words
+    void IndexDocument(int document_id, const std::vector<std::string_view>& words, DocumentStatus status,
+                       const std::vector<int>& ratings);
+
+    template <typename ExecutionPolicy>
+    void AddDocumentsImpl(ExecutionPolicy policy, const std::vector<DocumentRecord>& documents);
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
+        bool is_required;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // Sorted and deduplicated ids; words missing from the index are dropped.
+    // Required (`+word`) terms are plus terms as well.
+    // Temporaries of the query come from the same memory resource as the term vectors.
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_terms(resource)
+            , minus_terms(resource)
+            , required_terms(resource) {
+        }
+
+        std::pmr::memory_resource* GetResource() const {
+            return plus_terms.get_allocator().resource();
+        }
+
+        // Only documents containing every required word match
+        bool IsConjunctive() const {
+            return !required_terms.empty() || has_missing_required_word;
+        }
+
+        std::pmr::vector<TermId> plus_terms;
+        std::pmr::vector<TermId> minus_terms;
+        std::pmr::vector<TermId> required_terms;
+        // A required word is not in the index, so nothing matches
+        bool has_missing_required_word = false;
+    };
+
+    Query ParseQuery(std::string_view text, std::pmr::memory_resource* resource) const;
+
+    double ComputeTermInverseDocumentFreq(TermId term) const;
+
+    // Appends the query words found in the document to `matched_words`
+    DocumentStatus MatchParsedQuery(const Query& query, int document_id, std::vector<std::string_view>& matched_words) const;
+
+    class BudgetTracker {
+    public:
+        explicit BudgetTracker(const QueryBudget& budget)
+            : budget_(budget) {
+        }
+
+        // Accounts for one visited posting, returns false once the budget is exhausted
+        bool Consume() {
+            // Reading the clock on every posting would cost more than the posting itself
+            if (++postings_ > budget_.max_postings
+                || (postings_ % CLOCK_CHECK_PERIOD == 0 && std::chrono::steady_clock::now() >= budget_.deadline)) {
+                is_exhausted_ = true;
+            }
+            return !is_exhausted_;
+        }
+
+        bool IsExhausted() const {
+            return is_exhausted_;
+        }
+
+    private:
+        static const size_t CLOCK_CHECK_PERIOD = 256;
+
+        const QueryBudget& budget_;
+        size_t postings_ = 0;
+        bool is_exhausted_ = false;
+    };
+
+    // Charges an optional budget and counts the steps
+    class StepCounter {
+    public:
+        explicit StepCounter(BudgetTracker* budget)
+            : budget_(budget) {
+        }
+
+        bool Consume() {
+            ++steps_;
+            return !budget_ || budget_->Consume();
+        }
+
+        bool IsExhausted() const {
+            return budget_ && budget_->IsExhausted();
+        }
+
+        size_t GetSteps() const {
+            return steps_;
+        }
+
+    private:
+        BudgetTracker* const budget_;
+        size_t steps_ = 0;
     };
 
-    Query ParseQuery(std::string_view text) const;
+    // Lists the query words in the trace: plus words in query order, then minus words
+    void StartTrace(const Query& query, QueryTrace& trace) const;
+
+    bool HasAnyTerm(int document_id, const std::pmr::vector<TermId>& terms) const;
 
-    Query ParseQueryPar(std::string_view text) const;
+    bool HasAllTerms(int document_id, const std::pmr::vector<TermId>& terms) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Moves the best `count` documents to the front in ranking order and drops the rest
+    template <typename ExecutionPolicy>
+    static void SelectTopDocuments(ExecutionPolicy policy, std::pmr::vector<Document>& documents, size_t count);
 
+    // Only the sequential policy honours the budget tracker and fills the trace
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy policy, Query& query, DocumentPredicate document_predicate) const;
+    std::pmr::vector<Document> FindAllDocuments(ExecutionPolicy policy, Query& query, DocumentPredicate document_predicate,
+                                                BudgetTracker* budget = nullptr, QueryTrace* trace = nullptr) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(Query& query, DocumentPredicate document_predicate) const;
+    std::pmr::vector<Document> FindAllDocuments(Query& query, DocumentPredicate document_predicate) const;
+
+    // Intersects the required postings first and scores only the documents that survive
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::pmr::vector<Document> FindConjunctiveDocuments(ExecutionPolicy policy, Query& query, DocumentPredicate document_predicate,
+                                                        BudgetTracker* budget, QueryTrace* trace) const;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words) : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
+SearchServer::SearchServer(const StringContainer& stop_words) : stop_words_(MakeUniqueNonEmptyStrings<CountedSet<std::string, std::less<>>>(stop_words)) {
     for(const auto& sc : stop_words_) {
         if(!IsValidWord(sc)) {
             throw std::invalid_argument("This string contains forbidden characters");
@@ -121,20 +354,11 @@ SearchServer::SearchServer(const StringContainer& stop_words) : stop_words_(Make
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    auto query = ParseQuery(raw_query);
-    std::vector<Document> result = FindAllDocuments(policy, query, document_predicate);
-    sort(policy, result.begin(), result.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        result.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return result;
+    QueryArena arena;
+    auto query = ParseQuery(raw_query, arena.GetResource());
+    std::pmr::vector<Document> result = FindAllDocuments(policy, query, document_predicate);
+    SelectTopDocuments(policy, result, MAX_RESULT_DOCUMENT_COUNT);
+    return {result.begin(), result.end()};
 }
 
 template <typename ExecutionPolicy>
@@ -157,61 +381,202 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, Query& query, DocumentPredicate document_predicate) const {
-    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
-        std::map<int, double> document_to_relevance;
-        for (std::string_view word : query.plus_words) {
-            if (word_to_document_freqs_.count(std::string(word)) == 0) {
-                continue;
+std::vector<Document> SearchServer::FindTopDocumentsPage(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                         size_t offset, size_t limit) const {
+    QueryArena arena;
+    auto query = ParseQuery(raw_query, arena.GetResource());
+    std::pmr::vector<Document> result = FindAllDocuments(policy, query, document_predicate);
+    if (offset >= result.size()) {
+        return {};
+    }
+    SelectTopDocuments(policy, result, offset + std::min(limit, result.size() - offset));
+    return {result.begin() + offset, result.end()};
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsPage(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+                                                         size_t offset, size_t limit) const {
+    auto predicate = [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        };
+
+    return FindTopDocumentsPage(policy, raw_query, predicate, offset, limit);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsPage(ExecutionPolicy policy, std::string_view raw_query, size_t offset, size_t limit) const {
+    return FindTopDocumentsPage(policy, raw_query, DocumentStatus::ACTUAL, offset, limit);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, size_t offset, size_t limit) const {
+    return FindTopDocumentsPage(std::execution::seq, raw_query, document_predicate, offset, limit);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::SelectTopDocuments(ExecutionPolicy policy, std::pmr::vector<Document>& documents, size_t count) {
+    METRICS_SCOPE(MetricStage::TOP_K_SORT);
+    count = std::min(count, documents.size());
+    std::partial_sort(policy, documents.begin(), documents.begin() + count, documents.end(),
+        [](const Document& lhs, const Document& rhs) {
+            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+                return lhs.rating > rhs.rating;
+            } else {
+                return lhs.relevance > rhs.relevance;
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        });
+    documents.resize(count);
+}
+
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocumentsWithin(std::string_view raw_query, const QueryBudget& budget, DocumentPredicate document_predicate) const {
+    QueryArena arena;
+    auto query = ParseQuery(raw_query, arena.GetResource());
+    // The disjunctive traversal does not rely on the id order, shortest postings go first
+    if (!query.IsConjunctive()) {
+        std::sort(query.plus_terms.begin(), query.plus_terms.end(), [this](TermId lhs, TermId rhs) {
+            return postings_.GetDocumentFreq(lhs) < postings_.GetDocumentFreq(rhs);
+        });
+    }
+    BudgetTracker tracker(budget);
+    std::pmr::vector<Document> documents = FindAllDocuments(std::execution::seq, query, document_predicate, &tracker);
+    SelectTopDocuments(std::execution::seq, documents, MAX_RESULT_DOCUMENT_COUNT);
+    SearchResult result;
+    result.documents.assign(documents.begin(), documents.end());
+    result.is_partial = tracker.IsExhausted();
+    return result;
+}
+
+template <typename DocumentPredicate>
+ProfiledSearchResult SearchServer::ProfileFindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    using Clock = std::chrono::steady_clock;
+    QueryArena arena;
+    ProfiledSearchResult result;
+    QueryTrace& trace = result.trace;
+
+    const Clock::time_point parse_start = Clock::now();
+    auto query = ParseQuery(raw_query, arena.GetResource());
+    trace.parse_time = Clock::now() - parse_start;
+    StartTrace(query, trace);
+
+    std::pmr::vector<Document> documents = FindAllDocuments(std::execution::seq, query, document_predicate, nullptr, &trace);
+
+    const Clock::time_point top_k_start = Clock::now();
+    SelectTopDocuments(std::execution::seq, documents, MAX_RESULT_DOCUMENT_COUNT);
+    trace.top_k_time = Clock::now() - top_k_start;
+    result.documents.assign(documents.begin(), documents.end());
+    return result;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, Query& query, DocumentPredicate document_predicate,
+                                                          BudgetTracker* budget, QueryTrace* trace) const {
+    using Clock = std::chrono::steady_clock;
+    std::pmr::memory_resource* const resource = query.GetResource();
+    if (query.IsConjunctive()) {
+        return FindConjunctiveDocuments(policy, query, document_predicate, budget, trace);
+    }
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        std::pmr::map<int, double> document_to_relevance(resource);
+        const Clock::time_point traversal_start = trace ? Clock::now() : Clock::time_point();
+        {
+            METRICS_SCOPE(MetricStage::POSTING_TRAVERSAL);
+            for (size_t term_index = 0; term_index < query.plus_terms.size(); ++term_index) {
+                const TermId term = query.plus_terms[term_index];
+                if (postings_.GetDocumentFreq(term) == 0) {
+                    continue;
+                }
+                QueryTrace::Term* const term_trace = trace ? &trace->terms[term_index] : nullptr;
+                const double inverse_document_freq = ComputeTermInverseDocumentFreq(term);
+                postings_.ForEachPosting(term, [&](int document_id, double term_freq) {
+                    if (budget && !budget->Consume()) {
+                        return false;
+                    }
+                    const auto& document_data = documents_.at(document_id);
+                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                        document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                    } else if (term_trace) {
+                        ++term_trace->postings_filtered;
+                    }
+                    if (term_trace) {
+                        ++term_trace->postings_visited;
+                    }
+                    return true;
+                });
+                if (budget && budget->IsExhausted()) {
+                    break;
                 }
             }
-        }
 
-        for (std::string_view word : query.minus_words) {
-            if (word_to_document_freqs_.count(std::string(word)) == 0) {
-                continue;
+            const size_t accumulator_size = document_to_relevance.size();
+            if (budget && budget->IsExhausted()) {
+                // Minus postings may be long, the documents found so far are checked one by one instead
+                for (auto it = document_to_relevance.begin(); it != document_to_relevance.end();) {
+                    it = HasAnyTerm(it->first, query.minus_terms) ? document_to_relevance.erase(it) : std::next(it);
+                }
+            } else {
+                for (size_t term_index = 0; term_index < query.minus_terms.size(); ++term_index) {
+                    QueryTrace::Term* const term_trace = trace ? &trace->terms[query.plus_terms.size() + term_index] : nullptr;
+                    postings_.ForEachPosting(query.minus_terms[term_index], [&document_to_relevance, term_trace](int document_id, double) {
+                        document_to_relevance.erase(document_id);
+                        if (term_trace) {
+                            ++term_trace->postings_visited;
+                        }
+                        return true;
+                    });
+                }
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
-                document_to_relevance.erase(document_id);
+
+            if (trace) {
+                for (const QueryTrace::Term& term_trace : trace->terms) {
+                    trace->postings_visited += term_trace.postings_visited;
+                    trace->postings_filtered += term_trace.postings_filtered;
+                }
+                trace->accumulator_size = accumulator_size;
+                trace->documents_removed_by_minus = accumulator_size - document_to_relevance.size();
+                trace->traversal_time = Clock::now() - traversal_start;
             }
         }
 
-        std::vector<Document> matched_documents;
+        const Clock::time_point scoring_start = trace ? Clock::now() : Clock::time_point();
+        METRICS_SCOPE(MetricStage::SCORING);
+        std::pmr::vector<Document> matched_documents(resource);
         for (const auto [document_id, relevance] : document_to_relevance) {
             matched_documents.push_back(
                 {document_id, relevance, documents_.at(document_id).rating});
         }
+        if (trace) {
+            trace->scoring_time = Clock::now() - scoring_start;
+        }
         return matched_documents;
     } else {
         ConcurrentMap<int, double> document_to_relevance(100);
-
-        for_each(policy, query.plus_words.begin(), query.plus_words.end(), [this, &document_to_relevance, &document_predicate](std::string_view word){
-            if (word_to_document_freqs_.count(std::string(word)) == 0) {
-                return;
-            }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+        {
+            METRICS_SCOPE(MetricStage::POSTING_TRAVERSAL);
+            for_each(policy, query.plus_terms.begin(), query.plus_terms.end(), [this, &document_to_relevance, &document_predicate](TermId term){
+                if (postings_.GetDocumentFreq(term) == 0) {
+                    return;
                 }
-            }
-        });
-
-        for_each(policy, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](std::string_view word){
-            if (word_to_document_freqs_.count(std::string(word)) != 0) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
+                const double inverse_document_freq = ComputeTermInverseDocumentFreq(term);
+                postings_.ForEachPosting(term, [&](int document_id, double term_freq) {
+                    const auto& document_data = documents_.at(document_id);
+                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+                    }
+                    return true;
+                });
+            });
+
+            for_each(policy, query.minus_terms.begin(), query.minus_terms.end(), [this, &document_to_relevance](TermId term){
+                postings_.ForEachPosting(term, [&document_to_relevance](int document_id, double) {
                     document_to_relevance.Erase(document_id);
-                }
-            }
-        });
-        std::vector<Document> matched_documents;
+                    return true;
+                });
+            });
+        }
+
+        METRICS_SCOPE(MetricStage::SCORING);
+        std::pmr::vector<Document> matched_documents(resource);
         for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
             matched_documents.push_back(
                 {document_id, relevance, documents_.at(document_id).rating});
@@ -221,6 +586,83 @@ std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, Que
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(Query& query, DocumentPredicate document_predicate) const {
+std::pmr::vector<Document> SearchServer::FindAllDocuments(Query& query, DocumentPredicate document_predicate) const {
     return FindAllDocuments(std::execution::seq, query, document_predicate);
 }
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindConjunctiveDocuments(ExecutionPolicy policy, Query& query, DocumentPredicate document_predicate,
+                                                                  BudgetTracker* budget, QueryTrace* trace) const {
+    using Clock = std::chrono::steady_clock;
+    std::pmr::memory_resource* const resource = query.GetResource();
+    std::pmr::vector<Document> matched_documents(resource);
+    if (query.has_missing_required_word) {
+        return matched_documents;
+    }
+
+    std::pmr::vector<int> candidates(resource);
+    const auto collect_candidate = [&candidates](int document_id) {
+        candidates.push_back(document_id);
+    };
+    const Clock::time_point traversal_start = trace ? Clock::now() : Clock::time_point();
+    {
+        METRICS_SCOPE(MetricStage::POSTING_TRAVERSAL);
+        if (trace) {
+            StepCounter counter(budget);
+            postings_.ForEachCommonDocument(query.required_terms, &counter, collect_candidate);
+            size_t required_postings = 0;
+            for (const TermId term : query.required_terms) {
+                required_postings += postings_.GetDocumentFreq(term);
+            }
+            // Every candidate was confirmed by one posting of each of the other required words
+            const size_t read_postings = counter.GetSteps() + candidates.size() * (query.required_terms.size() - 1);
+            trace->postings_visited = counter.GetSteps();
+            trace->postings_skipped = required_postings > read_postings ? required_postings - read_postings : 0;
+            trace->accumulator_size = candidates.size();
+            trace->traversal_time = Clock::now() - traversal_start;
+        } else {
+            postings_.ForEachCommonDocument(query.required_terms, budget, collect_candidate);
+        }
+    }
+
+    const Clock::time_point scoring_start = trace ? Clock::now() : Clock::time_point();
+    METRICS_SCOPE(MetricStage::SCORING);
+    std::pmr::vector<double> inverse_document_freqs(resource);
+    inverse_document_freqs.reserve(query.plus_terms.size());
+    for (const TermId term : query.plus_terms) {
+        inverse_document_freqs.push_back(ComputeTermInverseDocumentFreq(term));
+    }
+    // Documents rejected by the predicate get id -1, documents with minus words get -2
+    matched_documents.resize(candidates.size());
+    std::transform(policy, candidates.begin(), candidates.end(), matched_documents.begin(),
+        [this, &query, &inverse_document_freqs, &document_predicate](int document_id) {
+            const auto& document_data = documents_.at(document_id);
+            if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+                return Document(-1, 0.0, 0);
+            }
+            if (HasAnyTerm(document_id, query.minus_terms)) {
+                return Document(-2, 0.0, 0);
+            }
+            const TermFrequencies document_terms = document_terms_freqs_.Get(document_id);
+            double relevance = 0.0;
+            IntersectSorted(query.plus_terms.begin(), query.plus_terms.end(), document_terms.begin(), document_terms.end(),
+                            [&query, &inverse_document_freqs, &relevance](auto term, auto record) {
+                                relevance += record->freq * inverse_document_freqs[term - query.plus_terms.begin()];
+                            },
+                            IdentityKey{}, [](const TermFrequency& record) { return record.term; });
+            return Document(document_id, relevance, document_data.rating);
+        });
+    if (trace) {
+        for (const Document& document : matched_documents) {
+            trace->postings_filtered += document.id == -1;
+            trace->documents_removed_by_minus += document.id == -2;
+        }
+    }
+    matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(), [](const Document& document) {
+        return document.id < 0;
+    }), matched_documents.end());
+    if (trace) {
+        trace->scoring_time = Clock::now() - scoring_start;
+    }
+    return matched_documents;
+}
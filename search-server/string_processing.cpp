@@ -2,8 +2,10 @@
 
 using namespace std;
 
-vector<string_view> SplitIntoWords(string_view str) {
-    vector<string_view> result;
+namespace {
+
+template <typename Container>
+void AppendWords(string_view str, Container& result) {
     str.remove_prefix(min(str.find_first_not_of(" "), str.size()));
     const int64_t pos_end = str.npos;
     while (!str.empty()) {
@@ -11,6 +13,18 @@ vector<string_view> SplitIntoWords(string_view str) {
         result.push_back(space == pos_end ? str.substr(0, str.size()) : str.substr(0, space));
         str.remove_prefix(min(str.find_first_not_of(" ", space), str.size()));
     }
+}
+
+}  // namespace
+
+vector<string_view> SplitIntoWords(string_view str) {
+    vector<string_view> result;
+    AppendWords(str, result);
+    return result;
+}
 
+pmr::vector<string_view> SplitIntoWords(string_view str, pmr::memory_resource* resource) {
+    pmr::vector<string_view> result(resource);
+    AppendWords(str, result);
     return result;
-}
\ No newline at end of file
+}
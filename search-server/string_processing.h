@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <memory_resource>
 #include <vector>
 #include <string>
 #include <set>
@@ -8,9 +9,11 @@
 
 std::vector<std::string_view> SplitIntoWords(std::string_view str);
 
-template <typename StringContainer>
-std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string, std::less<>> non_empty_strings;
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view str, std::pmr::memory_resource* resource);
+
+template <typename StringSet = std::set<std::string, std::less<>>, typename StringContainer>
+StringSet MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    StringSet non_empty_strings;
     for (const std::string_view& str : strings) {
         if (!str.empty()) {
             non_empty_strings.insert(std::string(str));
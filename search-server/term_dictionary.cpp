@@ -0,0 +1,96 @@
+#include "term_dictionary.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+using namespace std;
+
+TermId TermDictionary::Add(string_view word) {
+    if (const optional<TermId> id = Find(word)) {
+        return *id;
+    }
+    const TermId id = static_cast<TermId>(words_.size());
+    words_.push_back(Store(word));
+    if (words_.size() > filter_.GetCapacity()) {
+        GrowFilter();
+    } else {
+        filter_.Add(Hash(word));
+    }
+    recent_.emplace(words_.back(), id);
+    if (recent_.size() > max<size_t>(64, sorted_.size() / 8)) {
+        MergeRecent();
+    }
+    return id;
+}
+
+optional<TermId> TermDictionary::Find(string_view word) const {
+    if (!filter_.MayContain(Hash(word))) {
+        return nullopt;
+    }
+    const auto it = lower_bound(sorted_.begin(), sorted_.end(), word, [this](TermId id, string_view value) {
+        return words_[id] < value;
+    });
+    if (it != sorted_.end() && words_[*it] == word) {
+        return *it;
+    }
+    if (const auto recent_it = recent_.find(word); recent_it != recent_.end()) {
+        return recent_it->second;
+    }
+    return nullopt;
+}
+
+string_view TermDictionary::Store(string_view word) {
+    if (word.size() > tail_.free) {
+        const size_t chunk_size = max(CHUNK_SIZE, word.size());
+        chunks_.push_back(shared_ptr<char[]>(new char[chunk_size]));
+        tail_.data = chunks_.back().get();
+        tail_.free = chunk_size;
+        chunk_bytes_ += chunk_size;
+    }
+    memcpy(tail_.data, word.data(), word.size());
+    const string_view stored(tail_.data, word.size());
+    tail_.data += word.size();
+    tail_.free -= word.size();
+    return stored;
+}
+
+void TermDictionary::Compact() {
+    if (!recent_.empty()) {
+        MergeRecent();
+    }
+    chunks_.shrink_to_fit();
+    words_.shrink_to_fit();
+    sorted_.shrink_to_fit();
+}
+
+MemoryUsage TermDictionary::GetMemoryUsage() const {
+    const size_t bytes = chunk_bytes_ + GetVectorBytes(chunks_) + GetVectorBytes(words_) + GetVectorBytes(sorted_)
+        + GetNodeMemoryUsage(recent_).bytes + filter_.GetMemoryUsage();
+    return {bytes, words_.size()};
+}
+
+uint64_t TermDictionary::Hash(string_view word) {
+    return hash<string_view>{}(word);
+}
+
+void TermDictionary::GrowFilter() {
+    filter_ = BloomFilter(max<size_t>(1024, words_.size() * 2));
+    for (const string_view word : words_) {
+        filter_.Add(Hash(word));
+    }
+}
+
+void TermDictionary::MergeRecent() {
+    vector<TermId> recent;
+    recent.reserve(recent_.size());
+    for (const auto& [word, id] : recent_) {
+        recent.push_back(id);
+    }
+    vector<TermId> merged;
+    merged.reserve(sorted_.size() + recent.size());
+    merge(sorted_.begin(), sorted_.end(), recent.begin(), recent.end(), back_inserter(merged), [this](TermId lhs, TermId rhs) {
+        return words_[lhs] < words_[rhs];
+    });
+    sorted_ = move(merged);
+    recent_.clear();
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bloom_filter.h"
+#include "memory_usage.h"
+
+using TermId = uint32_t;
+
+// Assigns dense ids to the words of the index and keeps them in lexicographic
+// order for prefix lookups.
+//
+// Word bytes are packed back to back into large chunks instead of one heap
+// string per word. Chunks are immutable once shared: a copy of the dictionary
+// shares all chunks and starts writing into new ones, so word views returned by
+// GetWord stay valid for the lifetime of the dictionary and of all its copies.
+//
+// The sorted order is a flat array of ids (4 bytes per word) plus a small tree
+// of recently added words, which is merged into the array when it grows past
+// a fraction of the array size.
+//
+// A Bloom filter of all words answers most lookups of absent words (typos,
+// rare words) before any string comparison.
+class TermDictionary {
+public:
+    // Returns the id of the word, adding it if needed
+    TermId Add(std::string_view word);
+
+    std::optional<TermId> Find(std::string_view word) const;
+
+    // Writes to `out` the ids of at most `max_count` words starting with `prefix` for which
+    // accept(id) holds, the lexicographically smallest ones. Allocates nothing itself.
+    template <typename Predicate, typename OutputIt>
+    OutputIt FindPrefix(std::string_view prefix, size_t max_count, Predicate accept, OutputIt out) const;
+
+    std::string_view GetWord(TermId id) const {
+        return words_[id];
+    }
+
+    size_t size() const {
+        return words_.size();
+    }
+
+    // Merges the recently added words into the sorted array and releases slack capacity.
+    // Words are never dropped: ids stay valid.
+    void Compact();
+
+    // Chunks shared with copies are counted in full
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    // Free space of the last chunk. It is never carried over to a copy, which
+    // allocates its own chunk on the next Add instead.
+    struct WritableTail {
+        char* data = nullptr;
+        size_t free = 0;
+
+        WritableTail() = default;
+        WritableTail(const WritableTail&) {
+        }
+        WritableTail(WritableTail&& other) noexcept {
+            other = WritableTail();
+        }
+        WritableTail& operator=(const WritableTail&) {
+            data = nullptr;
+            free = 0;
+            return *this;
+        }
+        WritableTail& operator=(WritableTail&& other) noexcept {
+            data = nullptr;
+            free = 0;
+            other.data = nullptr;
+            other.free = 0;
+            return *this;
+        }
+    };
+
+    std::string_view Store(std::string_view word);
+
+    void MergeRecent();
+
+    static uint64_t Hash(std::string_view word);
+
+    // Rebuilds the filter for twice the current number of words
+    void GrowFilter();
+
+    std::vector<std::shared_ptr<char[]>> chunks_;
+    WritableTail tail_;
+    // Indexed by TermId
+    std::vector<std::string_view> words_;
+    // Ids sorted by word
+    std::vector<TermId> sorted_;
+    size_t chunk_bytes_ = 0;
+    CountedMap<std::string_view, TermId> recent_;
+    BloomFilter filter_;
+};
+
+template <typename Predicate, typename OutputIt>
+OutputIt TermDictionary::FindPrefix(std::string_view prefix, size_t max_count, Predicate accept, OutputIt out) const {
+    const auto has_prefix = [prefix](std::string_view word) {
+        return word.substr(0, prefix.size()) == prefix;
+    };
+    auto sorted_it = std::lower_bound(sorted_.begin(), sorted_.end(), prefix, [this](TermId id, std::string_view value) {
+        return words_[id] < value;
+    });
+    auto recent_it = recent_.lower_bound(prefix);
+
+    // Both sources are sorted, merge them to keep the smallest words
+    size_t count = 0;
+    while (count < max_count) {
+        const bool sorted_match = sorted_it != sorted_.end() && has_prefix(words_[*sorted_it]);
+        const bool recent_match = recent_it != recent_.end() && has_prefix(recent_it->first);
+        if (!sorted_match && !recent_match) {
+            break;
+        }
+        const TermId id = sorted_match && (!recent_match || words_[*sorted_it] < recent_it->first)
+            ? *sorted_it++
+            : (recent_it++)->second;
+        // Rejected words do not count towards max_count
+        if (accept(id)) {
+            *out++ = id;
+            ++count;
+        }
+    }
+    return out;
+}
@@ -1,11 +1,91 @@
 #include "remove_duplicates.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <set>
+
 using namespace std;
 
 void AddDocument(SearchServer& server, int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings) {
     server.AddDocument(document_id, document, status, ratings);
 }
 
+namespace {
+
+// Words of a document as indexes, the text is "w<index> ..."
+using Reference = map<int, set<int>>;
+
+string MakeText(const set<int>& words) {
+    string text;
+    for (const int word : words) {
+        text += "w"s + to_string(word) + " "s;
+    }
+    return text;
+}
+
+set<int> MakeWords(unsigned seed) {
+    // Low indexes are frequent, so the queries below have long posting lists
+    set<int> words;
+    for (int i = 0; i < 6; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const int word = static_cast<int>((seed >> 16) % 200);
+        words.insert(i < 3 ? word % 20 : word);
+    }
+    return words;
+}
+
+void AddReferenceDocument(SearchServer& server, Reference& reference, int document_id, unsigned seed) {
+    reference[document_id] = MakeWords(seed);
+    AddDocument(server, document_id, MakeText(reference[document_id]), DocumentStatus::ACTUAL, {1});
+}
+
+void RemoveReferenceDocument(SearchServer& server, Reference& reference, int document_id) {
+    reference.erase(document_id);
+    server.RemoveDocument(document_id);
+}
+
+// Relevance of every document found by the query
+map<int, double> FindAll(const SearchServer& server, const string& query) {
+    map<int, double> result;
+    for (const Document& document : server.FindTopDocumentsPage(query, 0, server.GetDocumentCount())) {
+        result[document.id] = document.relevance;
+    }
+    return result;
+}
+
+// Checks "w<a> w<b> -w<c>" and "+w<a> +w<b>" against the reference, returns the results
+vector<map<int, double>> CheckQueries(const SearchServer& server, const Reference& reference) {
+    vector<map<int, double>> results;
+    for (int a = 0; a < 20; a += 3) {
+        const int b = (a * 7 + 5) % 20;
+        const int c = (a * 11 + 3) % 200;
+        set<int> any_ids;
+        set<int> all_ids;
+        for (const auto& [document_id, words] : reference) {
+            if ((words.count(a) || words.count(b)) && !words.count(c)) {
+                any_ids.insert(document_id);
+            }
+            if (words.count(a) && words.count(b)) {
+                all_ids.insert(document_id);
+            }
+        }
+        for (const auto& [query, expected] : {pair{"w"s + to_string(a) + " w"s + to_string(b) + " -w"s + to_string(c), any_ids},
+                                              pair{"+w"s + to_string(a) + " +w"s + to_string(b), all_ids}}) {
+            results.push_back(FindAll(server, query));
+            set<int> found;
+            for (const auto& [document_id, relevance] : results.back()) {
+                found.insert(document_id);
+            }
+            assert(found == expected);
+        }
+    }
+    return results;
+}
+
+}  // namespace
+
 void TestRemoveDuplicates() {
     SearchServer search_server("and with"s);
 
@@ -37,3 +117,75 @@ void TestRemoveDuplicates() {
     RemoveDuplicates(search_server);
     cout << "After duplicates removed: "s << search_server.GetDocumentCount() << endl;
 }
+
+void TestPrefixSkipsRemovedWords() {
+    SearchServer search_server(""s);
+    search_server.SetMaxPrefixExpansion(2);
+
+    AddDocument(search_server, 1, "cata"s, DocumentStatus::ACTUAL, {1});
+    AddDocument(search_server, 2, "catb"s, DocumentStatus::ACTUAL, {1});
+    AddDocument(search_server, 3, "catz"s, DocumentStatus::ACTUAL, {1});
+
+    // слова удалённых документов остаются в словаре, но не должны занимать место в расширении префикса
+    search_server.RemoveDocument(1);
+    search_server.RemoveDocument(2);
+    assert(search_server.FindTopDocuments("cat*"s).size() == 1);
+    search_server.Compact();
+    const auto documents = search_server.FindTopDocuments("cat*"s);
+    assert(documents.size() == 1 && documents[0].id == 3);
+}
+
+void TestSegmentedIndex() {
+    SearchServer search_server(""s);
+    Reference reference;
+    const int buffer_size = static_cast<int>(PostingIndex::BUFFER_DOCUMENT_COUNT);
+
+    // несколько заполнений буфера запускают фоновые слияния сегментов
+    int next_id = 0;
+    for (; next_id < buffer_size * 3 + 100; ++next_id) {
+        AddReferenceDocument(search_server, reference, next_id, next_id);
+    }
+    // удаления сразу после заморозки буфера попадают на незавершённое слияние
+    for (int id = 0; id < next_id; id += 5) {
+        RemoveReferenceDocument(search_server, reference, id);
+    }
+    // удалённый id добавляется снова с другим текстом
+    for (int id = 0; id < next_id; id += 50) {
+        AddReferenceDocument(search_server, reference, id, id + 1000000);
+    }
+    CheckQueries(search_server, reference);
+
+    // ещё один сегмент, затем почти все его документы удаляются, и он переписывается
+    const int sparse_begin = next_id;
+    for (; next_id < sparse_begin + buffer_size * 2; ++next_id) {
+        AddReferenceDocument(search_server, reference, next_id, next_id);
+    }
+    for (int id = sparse_begin; id < next_id; ++id) {
+        if (id % 10 != 0) {
+            RemoveReferenceDocument(search_server, reference, id);
+        }
+    }
+    const vector<map<int, double>> before = CheckQueries(search_server, reference);
+
+    search_server.Compact();
+    const vector<map<int, double>> after = CheckQueries(search_server, reference);
+    assert(before.size() == after.size());
+    for (size_t i = 0; i < before.size(); ++i) {
+        assert(before[i].size() == after[i].size());
+        for (const auto& [document_id, relevance] : before[i]) {
+            assert(abs(after[i].at(document_id) - relevance) < 1e-9);
+        }
+    }
+
+    // после сжатия индекс продолжает принимать удаления и новые документы
+    for (int id = 1; id < sparse_begin; id += 7) {
+        if (reference.count(id)) {
+            RemoveReferenceDocument(search_server, reference, id);
+        }
+    }
+    for (int i = 0; i < buffer_size + 10; ++i, ++next_id) {
+        AddReferenceDocument(search_server, reference, next_id, next_id * 3);
+    }
+    CheckQueries(search_server, reference);
+    assert(search_server.GetDocumentCount() == static_cast<int>(reference.size()));
+}
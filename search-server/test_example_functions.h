@@ -5,3 +5,7 @@
 void AddDocument(SearchServer& server, int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings);
 
 void TestRemoveDuplicates();
+
+void TestPrefixSkipsRemovedWords();
+
+void TestSegmentedIndex();